@@ -150,18 +150,84 @@ static constexpr int64_t EMPTY_BLOCK_INTERVAL_MS = 10000;
 
 static constexpr uint64_t MIN_BLOCK_INTERVAL_MS = 1;
 
+// a proposal is made as soon as this many transactions are pending ...
+static constexpr uint64_t PROPOSAL_BATCH_SIZE = 1;
+
+// ... or when a pending transaction has waited this long after the min block interval
+static constexpr uint64_t PROPOSAL_LATENCY_MS = 0;
+
 static constexpr uint64_t COMMITTED_BLOCK_STORAGE_SIZE = 1;
 
 static constexpr uint64_t CATCHUP_INTERVAL_MS = 10000;
 
 static constexpr uint64_t WAIT_AFTER_NETWORK_ERROR_MS = 3000;
 
+static constexpr uint64_t CONSENSUS_BATCH_WINDOW_US = 100;
+
+// send multi-message consensus frames to all peers, not only to the ones that sent us such frames
+static constexpr bool CONSENSUS_FRAMES = false;
+
+static constexpr uint64_t CATCHUP_CHUNK_BLOCKS = 256;
+
+static constexpr uint64_t CATCHUP_CHUNK_BYTES = 16 * 1024 * 1024;
+
+// 0 keeps the kernel default
+static constexpr uint64_t SOCKET_SEND_BUFFER_SIZE = 0;
+
+static constexpr uint64_t SOCKET_RECEIVE_BUFFER_SIZE = 0;
+
+// "fifo" or "priority"
+static const char *const MEMPOOL_POLICY = "fifo";
+
+static constexpr uint64_t MAX_PENDING_TRANSACTIONS = 2 * MAX_TRANSACTIONS_PER_BLOCK;
+
+static constexpr uint64_t MAX_PENDING_TRANSACTION_BYTES = 256 * 1024 * 1024;
+
 
 
 // Non-tunable params
 
 static constexpr uint32_t SOCKET_BACKLOG = 64;
 
+static constexpr uint64_t PERSISTENT_CONNECTION_IDLE_TIMEOUT_MS = 300000;
+
+static constexpr uint64_t CATCHUP_SEGMENTS_AHEAD_PER_PEER = 2;
+
+static constexpr uint64_t CATCHUP_SEGMENT_TIMEOUT_MS = 5000;
+
+static constexpr uint64_t CATCHUP_LAG_THRESHOLD_BLOCKS = 2;
+
+static constexpr char BLOCK_KEY_PREFIX = 'B';
+
+static constexpr size_t BLOCK_KEY_LEN = 1 + 2 * sizeof(uint64_t);
+
+static constexpr uint64_t BLOCK_KEYS_VERSION = 2;
+
+static constexpr uint64_t BLOCK_KEY_MIGRATION_BATCH = 10000;
+
+static constexpr uint64_t BLOCK_LOG_SEGMENT_SIZE = 256 * 1024 * 1024;
+
+static constexpr uint64_t BLOCK_LOG_INITIAL_INDEX_ENTRIES = 65536;
+
+static constexpr uint64_t MAX_STORAGE_QUEUE_BLOCKS = 1024;
+
+static constexpr uint64_t CATCHUP_PERSIST_WAIT_MS = 1000;
+
+static constexpr char COMMITTED_TRANSACTIONS_KEY_PREFIX = 'T';
+
+static constexpr uint64_t COMMITTED_TRANSACTIONS_VERSION = 1;
+
+static constexpr uint64_t COMMITTED_FILTER_SNAPSHOT_INTERVAL_BLOCKS = 1000;
+
+static constexpr uint64_t MAX_POOLED_CONNECTIONS_PER_PEER = 4;
+
+// server workers one peer can occupy at a time, servers run this many workers per node
+static constexpr uint64_t MAX_SERVER_WORKERS_PER_PEER = 2;
+
+static constexpr uint64_t MAX_RECONNECT_BACKOFF_MS = 30000;
+
+static constexpr uint64_t SERVER_MAX_EPOLL_EVENTS = 256;
+
 static constexpr size_t SHA3_HASH_LEN = 32;
 
 static constexpr size_t PARTIAL_SHA_HASH_LEN = 8;
@@ -182,12 +248,46 @@ static constexpr uint64_t MAGIC_NUMBER = 0x1396A22050B30;
 
 static constexpr uint64_t TEST_MAGIC_NUMBER = 0x2456032650150;
 
+// capability flags sent by the client in the low bits of MAGIC_NUMBER
+
+// the server keeps the connection open for further requests
+static constexpr uint64_t PERSISTENT_CONNECTION_FLAG = 1;
+
+// the client reads binary headers, the server switches to them in its responses
+static constexpr uint64_t BINARY_HEADERS_FLAG = 2;
+
+static constexpr uint64_t MAGIC_FLAGS_MASK = 3;
+
+// a peer that did not acknowledge the capability flags gets plain requests for this long before it is probed again
+static constexpr uint64_t LEGACY_PEER_RECHECK_MS = 600000;
+
+static constexpr uint8_t BINARY_HEADER_VERSION = 1;
+
+static constexpr uint64_t MAX_OUTBOUND_MESSAGES_PER_PEER = 8192;
+
+static constexpr uint64_t MAX_OUTBOUND_RETRY_BACKOFF_MS = 128;
+
+static constexpr uint64_t MAX_DEFERRED_MESSAGES_PER_PEER = 65536;
+
+static constexpr uint64_t MAX_CONSENSUS_MESSAGES_PER_FRAME = 256;
+
 
 
 
 
 static const uint64_t KNOWN_TRANSACTIONS_HISTORY = 2 * MAX_TRANSACTIONS_PER_BLOCK;
 
+static constexpr uint64_t MEMPOOL_SHARD_COUNT = 16;
+
+// a full pending queue is reported as drained once it falls below this share of its limits
+static constexpr uint64_t PENDING_TRANSACTIONS_LOW_WATERMARK_PERCENT = 75;
+
+static constexpr uint64_t PENDING_QUEUE_WAIT_MS = 100;
+
+static constexpr uint64_t TRANSACTION_HASHING_CHUNK = 128;
+
+static constexpr uint64_t MAX_TRANSACTION_HASHING_THREADS = 8;
+
 
 enum port_type {
     PROPOSAL = 0, CATCHUP = 1, RETRIEVE = 2, HTTP_JSON = 3, BINARY_CONSENSUS = 4, ZMQ_BROADCAST = 5,
@@ -214,6 +314,14 @@ public:
     static constexpr const char *SCHAIN_DIR_NAME = "schains";
 };
 
+enum mempool_policy {
+    MEMPOOL_POLICY_FIFO = 0, MEMPOOL_POLICY_PRIORITY = 1
+};
+
+enum push_status {
+    PUSH_ACCEPTED = 0, PUSH_REJECTED = 1, PUSH_QUEUE_FULL = 2
+};
+
 enum BinaryDecision {
     DECISION_UNDECIDED, DECISION_TRUE, DECISION_FALSE
 };
@@ -272,7 +380,7 @@ inline std::string className(const std::string &prettyFunction) {
 
 //typedef map<schain_index, ptr<SHA3Hash> > proposed_block_hashes;
 
-static const num_threads NUM_SCHAIN_THREADS = num_threads(1);
+static const num_threads NUM_SCHAIN_THREADS = num_threads(4);
 
 
 static const num_threads NUM_DISPATCH_THREADS = num_threads(1);
@@ -29,6 +29,7 @@
 #include "../../node/Node.h"
 #include "../../Agent.h"
 #include "../network/ClientSocket.h"
+#include "../network/ClientConnectionPool.h"
 #include "../network/IO.h"
 #include "../exceptions/Exception.h"
 #include "../exceptions/FatalError.h"
@@ -85,8 +86,7 @@ void AbstractClientAgent::sendItem(ptr<BlockProposal> _proposal, schain_index _d
 
     ASSERT(getNode()->isStarted());
 
-    auto socket = make_shared<ClientSocket>(*sChain, _dstIndex, portType);
-
+    auto socket = getSchain()->getConnectionPool()->acquire(_dstIndex, portType);
 
 
     try {
@@ -101,6 +101,8 @@ void AbstractClientAgent::sendItem(ptr<BlockProposal> _proposal, schain_index _d
 
 
     sendItemImpl(_proposal, socket, _dstIndex, _dstNodeId);
+
+    getSchain()->getConnectionPool()->release(socket);
 }
 
 
@@ -128,6 +130,10 @@ void AbstractClientAgent::workerThreadItemSendLoop(AbstractClientAgent *agent) {
 
     auto destinationSubChainIndex = schain_index(agent->incrementAndReturnThreadCounter());
 
+    if (destinationSubChainIndex != agent->getSchain()->getSchainIndex()) {
+        agent->getSchain()->getConnectionPool()->warmUp(destinationSubChainIndex, agent->portType);
+    }
+
     try {
 
 
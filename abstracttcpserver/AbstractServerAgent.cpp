@@ -21,6 +21,10 @@
     @date 2018
 */
 
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
 #include "../SkaleConfig.h"
 #include "../Agent.h"
 #include "../Log.h"
@@ -54,6 +58,7 @@
 #include "../network/IO.h"
 #include "../network/Buffer.h"
 #include "../network/Connection.h"
+#include "../node/NodeInfo.h"
 #include "../network/TCPServerSocket.h"
 #include "../datastructures/PartialHashesList.h"
 
@@ -63,7 +68,7 @@
 
 void AbstractServerAgent::pushToQueueAndNotifyWorkers(ptr<Connection> connectionEnvelope) {
     lock_guard<mutex> lock(incomingTCPConnectionsMutex);
-    incomingTCPConnections.push(connectionEnvelope);
+    incomingTCPConnections.push_back(connectionEnvelope);
     incomingTCPConnectionsCond.notify_all();
 }
 
@@ -71,20 +76,59 @@ ptr<Connection> AbstractServerAgent::workerThreadWaitandPopConnection() {
 
     unique_lock<mutex> mlock(incomingTCPConnectionsMutex);
 
-    while (incomingTCPConnections.empty()) {
+    while (true) {
+
+        for (auto it = incomingTCPConnections.begin(); it != incomingTCPConnections.end(); it++) {
+
+            auto &ip = *(*it)->getIP();
+
+            // entries exist only while a worker is busy, release() erases them at zero
+            auto busy = busyWorkersPerIP.find(ip);
+
+            uint64_t count = busy == busyWorkersPerIP.end() ? 0 : busy->second;
+
+            if (count < getWorkerLimit(ip)) {
+                busyWorkersPerIP[ip] = count + 1;
+                ptr<Connection> ce = *it;
+                incomingTCPConnections.erase(it);
+                return ce;
+            }
+        }
+
         incomingTCPConnectionsCond.wait(mlock);
         getSchain()->getNode()->exitCheck();
     }
+}
 
 
-    ASSERT(!incomingTCPConnections.empty());
+uint64_t AbstractServerAgent::getWorkerLimit(const string &_ip) {
 
-    ptr<Connection> ce = incomingTCPConnections.front();
+    auto limit = workerLimitPerIP.find(_ip);
+
+    // not a configured node
+    if (limit == workerLimitPerIP.end())
+        return MAX_SERVER_WORKERS_PER_PEER;
+
+    return limit->second;
+}
 
-    incomingTCPConnections.pop();
 
-    return ce;
+void AbstractServerAgent::releaseWorker(const ptr<Connection> &_connection) {
 
+    {
+        lock_guard<mutex> lock(incomingTCPConnectionsMutex);
+
+        auto busy = busyWorkersPerIP.find(*_connection->getIP());
+
+        ASSERT(busy != busyWorkersPerIP.end() && busy->second > 0);
+
+        if (--busy->second == 0) {
+            busyWorkersPerIP.erase(busy);
+        }
+    }
+
+    // a connection of this peer may be waiting for the worker
+    incomingTCPConnectionsCond.notify_all();
 }
 
 
@@ -101,13 +145,24 @@ void AbstractServerAgent::workerThreadConnectionProcessingLoop(void *_params) {
 
 
     while (!server->getNode()->isExitRequested()) {
+
+        ptr<Connection> connection = nullptr;
+
         try {
 
-            ptr<Connection> connection = server->workerThreadWaitandPopConnection();
+            connection = server->workerThreadWaitandPopConnection();
             server->processNextAvailableConnection(connection);
+
+            if (connection->isPersistent()) {
+                server->watchConnection(connection);
+            }
         } catch (Exception &e) {
             Exception::log_exception(e);
         }
+
+        if (connection) {
+            server->releaseWorker(connection);
+        }
     }
 }
 
@@ -119,7 +174,7 @@ void AbstractServerAgent::send(ptr<Connection> _connectionEnvelope,
     ASSERT(_connectionEnvelope);
     ASSERT(_header);
     ASSERT(_header->isComplete());
-    auto buf = _header->toBuffer();
+    auto buf = _header->toBuffer(_connectionEnvelope->isBinaryHeaders());
 
     getSchain()->getIo()->writeBuf(_connectionEnvelope->getDescriptor(), buf);
 }
@@ -129,51 +184,199 @@ AbstractServerAgent::AbstractServerAgent(const string &_name, Schain &_schain,
         : Agent(_schain, true), name(_name), socket(_socket) {
 
     logThreadLocal_ = _schain.getNode()->getLog();
+
+    // nodes that share an IP, as in local tests, share its limit
+    for (auto &&item : _schain.getNode()->getNodeInfosByIndex()) {
+        workerLimitPerIP[*item.second->getBaseIP()] += MAX_SERVER_WORKERS_PER_PEER;
+    }
+
+    epollFD = epoll_create1(0);
+
+    ASSERT(epollFD >= 0);
+
+    wakeupFD = eventfd(0, EFD_NONBLOCK);
+
+    ASSERT(wakeupFD >= 0);
 }
 
 AbstractServerAgent::~AbstractServerAgent() {
     this->networkReadThread->join();
+    close(epollFD);
+    close(wakeupFD);
+}
+
+
+void AbstractServerAgent::watchConnection(ptr<Connection> _connection) {
+
+    _connection->setIdleSinceMs(Schain::getCurrentTimeMs());
+
+    auto fd = (int) _connection->getDescriptor();
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    event.data.fd = fd;
+
+    lock_guard<mutex> lock(waitingConnectionsMutex);
+
+    waitingConnections[fd] = _connection;
+
+    if (epoll_ctl(epollFD, EPOLL_CTL_ADD, fd, &event) < 0) {
+        waitingConnections.erase(fd);
+        LOG(err, name + " Could not watch connection:" + string(strerror(errno)));
+    }
 }
 
-void AbstractServerAgent::acceptTCPConnectionsLoop() {
+
+ptr<Connection> AbstractServerAgent::unwatchConnection(int _fd) {
+
+    lock_guard<mutex> lock(waitingConnectionsMutex);
+
+    auto it = waitingConnections.find(_fd);
+
+    if (it == waitingConnections.end())
+        return nullptr;
+
+    auto connection = it->second;
+
+    epoll_ctl(epollFD, EPOLL_CTL_DEL, _fd, nullptr);
+
+    waitingConnections.erase(it);
+
+    return connection;
+}
+
+
+void AbstractServerAgent::acceptTCPConnections(int _listenSocket) {
+
+    struct sockaddr_in clientAddress;
+
+    while (true) {
+
+        socklen_t sizeOfClientAddress = sizeof(clientAddress);
+
+        int newConnection = accept(_listenSocket, (sockaddr *) &clientAddress, &sizeOfClientAddress);
+
+        if (newConnection < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                return;
+            BOOST_THROW_EXCEPTION(NetworkProtocolException("accept failed:" + string(strerror(errno)), __CLASS_NAME__));
+        }
+
+        Sockets::setTCPOptions(newConnection, getNode()->getSocketSendBufferSize(),
+                               getNode()->getSocketReceiveBufferSize());
+
+        char *ip(inet_ntoa(clientAddress.sin_addr));
+
+        // a worker only gets the connection once the request is readable
+        watchConnection(make_shared<Connection>(newConnection, make_shared<string>(ip)));
+    }
+}
+
+
+void AbstractServerAgent::dropExpiredConnections() {
+
+    auto now = Schain::getCurrentTimeMs();
+
+    lock_guard<mutex> lock(waitingConnectionsMutex);
+
+    for (auto it = waitingConnections.begin(); it != waitingConnections.end();) {
+        if (now - it->second->getIdleSinceMs() > PERSISTENT_CONNECTION_IDLE_TIMEOUT_MS) {
+            epoll_ctl(epollFD, EPOLL_CTL_DEL, it->first, nullptr);
+            it = waitingConnections.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
+
+
+void AbstractServerAgent::serverEventLoop() {
 
     setThreadName(__CLASS_NAME__);
 
     waitOnGlobalStartBarrier();
 
-    struct sockaddr_in clientAddress;
-    socklen_t sizeOfClientAddress = sizeof(clientAddress);
     ASSERT(this->socket > 0);
     auto s = this->socket->getDescriptor();
     ASSERT(s > 0);
+
+    fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+
+    event.data.fd = s;
+    epoll_ctl(epollFD, EPOLL_CTL_ADD, s, &event);
+
+    event.data.fd = wakeupFD;
+    epoll_ctl(epollFD, EPOLL_CTL_ADD, wakeupFD, &event);
+
+    vector<struct epoll_event> events(SERVER_MAX_EPOLL_EVENTS);
+
+    uint64_t lastExpiryCheckMs = Schain::getCurrentTimeMs();
+
     try {
 
         while (!getSchain()->getNode()->isExitRequested()) {
 
-            int newConnection = accept(s, (sockaddr *) &clientAddress, &sizeOfClientAddress);
+            auto count = epoll_wait(epollFD, events.data(), (int) events.size(), 1000);
 
-            if (getSchain()->getNode()->isExitRequested()) {
-                return;
-            }
+            if (getSchain()->getNode()->isExitRequested())
+                break;
 
-            if (newConnection < 0) {
-                BOOST_THROW_EXCEPTION(NetworkProtocolException("accept failed:" + string(strerror(errno)), __CLASS_NAME__));
-            }
+            for (int i = 0; i < count; i++) {
+
+                auto fd = events[i].data.fd;
+
+                if (fd == s) {
+                    acceptTCPConnections(s);
+                    continue;
+                }
+
+                if (fd == wakeupFD) {
+                    uint64_t counter;
+                    auto result = read(wakeupFD, &counter, sizeof(counter));
+                    (void) result;
+                    continue;
+                }
+
+                auto connection = unwatchConnection(fd);
 
-            char *ip(inet_ntoa(clientAddress.sin_addr));
+                if (!connection)
+                    continue;
 
-            this->pushToQueueAndNotifyWorkers(make_shared<Connection>(newConnection, make_shared<string>(ip)));
+                char c;
 
+                // the client closed the connection, drop it quietly
+                if ((events[i].events & (EPOLLERR | EPOLLHUP)) ||
+                    recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) <= 0) {
+                    continue;
+                }
+
+                connection->setMagicFlags(0);
+
+                pushToQueueAndNotifyWorkers(connection);
+            }
+
+            if (Schain::getCurrentTimeMs() - lastExpiryCheckMs > 1000) {
+                dropExpiredConnections();
+                lastExpiryCheckMs = Schain::getCurrentTimeMs();
+            }
         }
     } catch (FatalError *e) {
         getNode()->exitOnFatalError(e->getMessage());
     }
+
+    lock_guard<mutex> lock(waitingConnectionsMutex);
+    waitingConnections.clear();
 }
 
 void AbstractServerAgent::createNetworkReadThread() {
 
     LOG(info, name + " Starting TCP server network read loop");
-    networkReadThread = make_shared<thread>(std::bind(&AbstractServerAgent::acceptTCPConnectionsLoop, this));
+    networkReadThread = make_shared<thread>(std::bind(&AbstractServerAgent::serverEventLoop, this));
     LOG(info, name + " Started TCP server network read loop");
 
 }
@@ -210,6 +413,9 @@ void AbstractServerAgent::notifyAllConditionVariables() {
     LOG(trace, "Notifying TCP cond" + to_string((uint64_t) (void *) &incomingTCPConnectionsCond));
     incomingTCPConnectionsCond.notify_all();
 
+    uint64_t one = 1;
+    auto result = write(wakeupFD, &one, sizeof(one));
+    (void) result;
 }
 
 
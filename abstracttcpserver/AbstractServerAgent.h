@@ -50,6 +50,41 @@ protected:
 
     condition_variable incomingTCPConnectionsCond;
 
+    /**
+     * Workers busy with requests of each peer IP, and how many a peer IP may use. Guarded by
+     * incomingTCPConnectionsMutex
+     */
+    map<string, uint64_t> busyWorkersPerIP;
+
+    map<string, uint64_t> workerLimitPerIP;
+
+    uint64_t getWorkerLimit(const string &_ip);
+
+    void releaseWorker(const ptr<Connection> &_connection);
+
+
+    /**
+     * Connections waiting for their next request, by descriptor. They are watched by the event
+     * loop and handed to a worker only when the request is readable, so a slow or idle peer
+     * never occupies a worker
+     */
+    mutex waitingConnectionsMutex;
+
+    map<int, ptr<Connection>> waitingConnections;
+
+    int epollFD;
+
+    int wakeupFD;
+
+    void watchConnection(ptr<Connection> _connection);
+
+    ptr<Connection> unwatchConnection(int _fd);
+
+    void acceptTCPConnections(int _listenSocket);
+
+    void dropExpiredConnections();
+
+
 
 
     void send(ptr<Connection> _connectionEnvelope, ptr<Header> _header);
@@ -63,13 +98,17 @@ public:
     ~AbstractServerAgent() override;
 
 
-    queue<ptr<Connection>> incomingTCPConnections;
+    deque<ptr<Connection>> incomingTCPConnections;
 
 
 
 
     void pushToQueueAndNotifyWorkers(ptr<Connection> connectionEnvelope);
 
+    /**
+     * Pops the first connection whose peer is below its worker limit, so that a slow peer can not
+     * occupy more than its share of workers
+     */
     ptr<Connection> workerThreadWaitandPopConnection();
 
     static void workerThreadConnectionProcessingLoop(void* _params);
@@ -87,7 +126,7 @@ public:
 
 
 
-    void acceptTCPConnectionsLoop();
+    void serverEventLoop();
 
 
     void createNetworkReadThread();
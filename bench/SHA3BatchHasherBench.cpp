@@ -0,0 +1,118 @@
+/*
+    Copyright (C) 2019 SKALE Labs
+
+    This file is part of skale-consensus.
+
+    skale-consensus is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    skale-consensus is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with skale-consensus.  If not, see <http://www.gnu.org/licenses/>.
+
+    @file SHA3BatchHasherBench.cpp
+    @author Stan Kladko
+    @date 2019
+*/
+
+
+#include <random>
+
+#include "../SkaleConfig.h"
+#include "../crypto/SHA3BatchHasher.h"
+
+
+/**
+ * Compares SHA3BatchHasher with hashing one transaction at a time through CryptoPP,
+ * which is what Transaction::getHash did before. Exits with 1 if any digest differs.
+ *
+ * Usage: sha3bench [transactions] [transaction bytes] [rounds]
+ */
+
+
+static uint64_t bestTimeNs(uint64_t _rounds, const function<void()> &_run) {
+
+    uint64_t best = UINT64_MAX;
+
+    for (uint64_t i = 0; i < _rounds; i++) {
+        auto start = chrono::steady_clock::now();
+        _run();
+        auto ns = (uint64_t) chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        best = min(best, ns);
+    }
+
+    return max(best, (uint64_t) 1);
+}
+
+
+static void report(const string &_name, uint64_t _ns, uint64_t _count, uint64_t _bytes) {
+    printf("%-12s %10.3f ms %12.0f tx/s %10.1f MB/s\n", _name.c_str(), _ns / 1e6, _count * 1e9 / _ns,
+           _bytes * 1e3 / _ns);
+}
+
+
+int main(int argc, char **argv) {
+
+    uint64_t count = argc > 1 ? stoull(argv[1]) : 10000;
+    uint64_t size = argc > 2 ? stoull(argv[2]) : 200;
+    uint64_t rounds = argc > 3 ? stoull(argv[3]) : 20;
+
+    // every length within 16 bytes of the nominal size, like a block of similar transactions
+    vector<vector<uint8_t>> transactions(count);
+
+    mt19937_64 random(1);
+
+    uint64_t totalBytes = 0;
+
+    for (auto &&transaction : transactions) {
+        transaction.resize(size > 16 ? size - random() % 16 : size);
+        for (auto &&byte : transaction) {
+            byte = (uint8_t) random();
+        }
+        totalBytes += transaction.size();
+    }
+
+    vector<const uint8_t *> messages;
+    vector<uint64_t> lengths;
+
+    for (auto &&transaction : transactions) {
+        messages.push_back(transaction.data());
+        lengths.push_back(transaction.size());
+    }
+
+    vector<uint8_t> expected(count * SHA3_HASH_LEN);
+    vector<uint8_t> actual(count * SHA3_HASH_LEN);
+
+    auto baselineNs = bestTimeNs(rounds, [&]() {
+        for (uint64_t i = 0; i < count; i++) {
+            CryptoPP::SHA3 hashObject(SHA3_HASH_LEN);
+            hashObject.Update(messages[i], lengths[i]);
+            hashObject.Final(expected.data() + i * SHA3_HASH_LEN);
+        }
+    });
+
+    auto batchNs = bestTimeNs(rounds, [&]() {
+        SHA3BatchHasher::hash(messages.data(), lengths.data(), count, actual.data());
+    });
+
+    printf("transactions:%lu bytes:%lu rounds:%lu lanes:%lu\n", (unsigned long) count, (unsigned long) size,
+           (unsigned long) rounds, (unsigned long) SHA3BatchHasher::getLanes());
+
+    report("cryptopp", baselineNs, count, totalBytes);
+    report("batch", batchNs, count, totalBytes);
+
+    printf("speedup:%.2f\n", (double) baselineNs / batchNs);
+
+    if (expected != actual) {
+        printf("DIGESTS DIFFER\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -68,7 +68,7 @@ BlockFinalizeClientAgent::BlockFinalizeClientAgent(Schain &_sChain) : AbstractCl
 
 
 nlohmann::json BlockFinalizeClientAgent::readProposalResponseHeader(ptr<ClientSocket> _socket) {
-    return sChain->getIo()->readJsonHeader(_socket->getDescriptor(), "Read proposal resp");
+    return sChain->getIo()->readJsonHeader(_socket, "Read proposal resp");
 }
 
 
@@ -99,7 +99,7 @@ void BlockFinalizeClientAgent::sendItemImpl(ptr<BlockProposal> &_proposal, share
 
     LOG(trace, "Proposal step 1: wrote proposal header");
 
-    auto response = sChain->getIo()->readJsonHeader(socket->getDescriptor(), "Read proposal resp");
+    auto response = sChain->getIo()->readJsonHeader(socket, "Read proposal resp");
 
 
     LOG(trace, "Proposal step 2: read proposal response");
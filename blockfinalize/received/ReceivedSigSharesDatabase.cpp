@@ -38,6 +38,7 @@
 #include "../../crypto/BLSSigShare.h"
 #include "../../pendingqueue/PendingTransactionsAgent.h"
 #include "../../datastructures/SigShareSet.h"
+#include "../../db/StorageAgent.h"
 
 #include "ReceivedSigSharesDatabase.h"
 
@@ -75,10 +76,7 @@ void ReceivedSigSharesDatabase::mergeAndSaveBLSSignature(block_id _blockId) {
     auto signature = sigSet->mergeSignature();
     blockSignatures[_blockId] = signature;
 
-    auto db = getNode()->getSignaturesDB();
-    auto key = to_string(_blockId);
-    if (db->readString(key) == nullptr)
-    getNode()->getSignaturesDB()->writeString(key, *signature->toString());
+    getSchain()->getStorageAgent()->saveSignature(to_string(_blockId), *signature->toString());
 
     sigShareSets[_blockId] = nullptr;
 }
@@ -67,14 +67,14 @@ BlockProposalClientAgent::BlockProposalClientAgent(Schain &_sChain) : AbstractCl
 
 
 nlohmann::json BlockProposalClientAgent::readProposalResponseHeader(ptr<ClientSocket> _socket) {
-    return sChain->getIo()->readJsonHeader(_socket->getDescriptor(), "Read proposal resp");
+    return sChain->getIo()->readJsonHeader(_socket, "Read proposal resp");
 }
 
 
 ptr<MissingTransactionsRequestHeader>
 BlockProposalClientAgent::readAndProcessMissingTransactionsRequestHeader(
         ptr<ClientSocket> _socket) {
-    auto js = sChain->getIo()->readJsonHeader(_socket->getDescriptor(), "Read missing trans request");
+    auto js = sChain->getIo()->readJsonHeader(_socket, "Read missing trans request");
     auto mtrh = make_shared<MissingTransactionsRequestHeader>();
 
     auto status = (ConnectionStatus) Header::getUint64(js, "status");
@@ -93,8 +93,8 @@ BlockProposalClientAgent::readAndProcessMissingTransactionsRequestHeader(
 
 
 void
-BlockProposalClientAgent::sendItemImpl(ptr<BlockProposal> &_proposal, shared_ptr<ClientSocket> &socket, schain_index,
-                                       node_id ) {
+BlockProposalClientAgent::sendItemImpl(ptr<BlockProposal> &_proposal, shared_ptr<ClientSocket> &socket,
+                                       schain_index _dstIndex, node_id ) {
 
     LOG(trace, "Proposal step 0: Starting block proposal");
 
@@ -113,16 +113,21 @@ BlockProposalClientAgent::sendItemImpl(ptr<BlockProposal> &_proposal, shared_ptr
 
     LOG(trace, "Proposal step 1: wrote proposal header");
 
-    auto response = sChain->getIo()->readJsonHeader(socket->getDescriptor(), "Read proposal resp");
+    auto response = sChain->getIo()->readJsonHeader(socket, "Read proposal resp");
 
 
     LOG(trace, "Proposal step 2: read proposal response");
 
 
     auto status = (ConnectionStatus) Header::getUint64(response, "status");
-    // auto substatus = (ConnectionSubStatus) Header::getUint64(response, "substatus");
+    auto substatus = (ConnectionSubStatus) Header::getUint64(response, "substatus");
 
 
+    if (status == CONNECTION_DISCONNECT && substatus == CONNECTION_BLOCK_PROPOSAL_TOO_LATE) {
+        // the peer already committed the block we are proposing
+        sChain->lagDetected(_dstIndex, (uint64_t) _proposal->getBlockID());
+    }
+
     if (status != CONNECTION_PROCEED) {
         LOG(trace, "Proposal Server terminated proposal push");
         return;
@@ -138,15 +138,15 @@ pair<ptr<map<uint64_t, ptr<Transaction>>>,
     auto presentTransactions = make_shared<map<uint64_t, ptr<Transaction> > >();
     auto missingHashes = make_shared<map<uint64_t, ptr<partial_sha_hash> > >();
 
+    vector<ptr<Transaction>> knownTransactions;
+
+    subChain_.getPendingTransactionsAgent()->getKnownTransactionsByPartialHashes(_phm, knownTransactions);
+
     for (uint64_t i = 0; i < transactionsCount; i++) {
-        auto hash = _phm->getPartialHash(i);
-        ASSERT(hash);
-        auto transaction =
-                subChain_.getPendingTransactionsAgent()->getKnownTransactionByPartialHash(hash);
-        if (transaction == nullptr) {
-            (*missingHashes)[i] = hash;
+        if (knownTransactions[i] == nullptr) {
+            (*missingHashes)[i] = _phm->getPartialHash(i);
         } else {
-            (*presentTransactions)[i] = transaction;
+            (*presentTransactions)[i] = knownTransactions[i];
         }
     }
 
@@ -157,7 +157,7 @@ pair<ptr<map<uint64_t, ptr<Transaction>>>,
 BlockProposalServerAgent::BlockProposalServerAgent(Schain &_schain, ptr<TCPServerSocket> _s)
         : AbstractServerAgent("Block proposal server", _schain, _s) {
     blockProposalWorkerThreadPool =
-            make_shared<BlockProposalWorkerThreadPool>(num_threads(1), this);
+            make_shared<BlockProposalWorkerThreadPool>(num_threads((uint64_t) _schain.getNodeCount() * MAX_SERVER_WORKERS_PER_PEER), this);
     blockProposalWorkerThreadPool->startService();
     createNetworkReadThread();
 }
@@ -169,7 +169,7 @@ void BlockProposalServerAgent::processNextAvailableConnection(ptr<Connection> _c
 
 
     try {
-        sChain->getIo()->readMagic(_connection->getDescriptor());
+        sChain->getIo()->readMagic(_connection);
     }
     catch (ExitRequestedException &) { throw; }
     catch (PingException &) { return; }
@@ -253,6 +253,7 @@ BlockProposalServerAgent::processProposalRequest(ptr<Connection> _connection, nl
     auto proposerIndex = schain_index(Header::getUint64(_proposalRequest, "proposerIndex"));
     auto blockID = block_id(Header::getUint64(_proposalRequest, "blockID"));
     auto timeStamp = Header::getUint64(_proposalRequest, "timeStamp");
+    auto timeStampMs = Header::getTimeStampMs(_proposalRequest);
     auto hash = Header::getString(_proposalRequest, "hash");
 
 
@@ -356,7 +357,8 @@ BlockProposalServerAgent::processProposalRequest(ptr<Connection> _connection, nl
     auto transactionList = make_shared<TransactionList>(transactions);
 
     auto proposal =
-            make_shared<ReceivedBlockProposal>(*sChain, blockID, proposerIndex, transactionList, timeStamp);
+            make_shared<ReceivedBlockProposal>(*sChain, blockID, proposerIndex, transactionList, timeStamp,
+                                               timeStampMs);
 
     auto calculatedHash = proposal->getHash();
 
@@ -419,6 +421,7 @@ ptr<Header> BlockProposalServerAgent::createProposalResponseHeader(
     schain_index proposerIndex;
     schain_id schainID;
     uint64_t timeStamp;
+    uint32_t timeStampMs;
     ptr<string> hash;
 
 
@@ -427,6 +430,7 @@ ptr<Header> BlockProposalServerAgent::createProposalResponseHeader(
     srcNodeID = Header::getUint64(_jsonRequest, "proposerNodeID");
     proposerIndex = Header::getUint64(_jsonRequest, "proposerIndex");
     timeStamp = Header::getUint64(_jsonRequest, "timeStamp");
+    timeStampMs = Header::getTimeStampMs(_jsonRequest);
     hash = Header::getString(_jsonRequest, "hash");
 
 
@@ -473,13 +477,15 @@ ptr<Header> BlockProposalServerAgent::createProposalResponseHeader(
 
     ASSERT(timeStamp > MODERN_TIME);
 
-    auto t = Schain::getCurrentTimeSec();
+    auto t = Schain::getCurrentTimeMs();
+
+    assert(t < (uint64_t) MODERN_TIME * 2 * 1000);
 
-    assert(t < (uint64_t) MODERN_TIME * 2);
+    auto proposalTimeMs = timeStamp * 1000 + timeStampMs;
 
-    if (Schain::getCurrentTimeSec() + 1 < timeStamp) {
+    if (t + 1000 < proposalTimeMs) {
         LOG(info,
-            "Incorrect timestamp:" + to_string(timeStamp) + ":vs:" + to_string(Schain::getCurrentTimeSec()));
+            "Incorrect timestamp:" + to_string(proposalTimeMs) + ":vs:" + to_string(t));
         responseHeader->setStatusSubStatus(
                 CONNECTION_DISCONNECT, CONNECTION_ERROR_TIME_STAMP_IN_THE_FUTURE);
         responseHeader->setComplete();
@@ -488,9 +494,11 @@ ptr<Header> BlockProposalServerAgent::createProposalResponseHeader(
     }
 
 
-    if (sChain->getCommittedBlockTimeStamp() >= timeStamp) {
-        LOG(info, "Incorrect timestamp:" + to_string(timeStamp) +
-                  ":vs:" + to_string(sChain->getCommittedBlockTimeStamp()));
+    auto committedTimeMs = sChain->getCommittedBlockTimeStamp() * 1000 + sChain->getCommittedBlockTimeStampMs();
+
+    if (committedTimeMs >= proposalTimeMs) {
+        LOG(info, "Incorrect timestamp:" + to_string(proposalTimeMs) +
+                  ":vs:" + to_string(committedTimeMs));
 
         responseHeader->setStatusSubStatus(
                 CONNECTION_DISCONNECT, CONNECTION_ERROR_TIME_STAMP_EARLIER_THAN_COMMITTED);
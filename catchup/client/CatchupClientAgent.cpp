@@ -32,12 +32,14 @@
 #include "../../abstracttcpserver/ConnectionStatus.h"
 
 #include "../../network/ClientSocket.h"
+#include "../../network/ClientConnectionPool.h"
 #include "../../network/IO.h"
 #include "../../network/TransportNetwork.h"
 #include "../../node/Node.h"
 
 #include "../../crypto/SHAHash.h"
 #include "../../chains/Schain.h"
+#include "../../datastructures/CommittedBlock.h"
 #include "../../datastructures/CommittedBlockList.h"
 #include "../../exceptions/NetworkProtocolException.h"
 #include "../../headers/BlockProposalHeader.h"
@@ -47,6 +49,7 @@
 
 #include "CatchupClientAgent.h"
 #include "CatchupClientThreadPool.h"
+#include "CatchupSegmentScheduler.h"
 
 
 CatchupClientAgent::CatchupClientAgent( Schain& _sChain ) : Agent( _sChain, false ) {
@@ -54,24 +57,55 @@ CatchupClientAgent::CatchupClientAgent( Schain& _sChain ) : Agent( _sChain, fals
     this->sChain = &_sChain;
     threadCounter = 0;
 
+    scheduler = make_shared< CatchupSegmentScheduler >( _sChain );
+
     if ( _sChain.getNodeCount() > 1 ) {
-        this->catchupClientThreadPool = make_shared< CatchupClientThreadPool >( 1, this );
+        // one segment download thread per peer plus the periodic catchup thread
+        this->catchupClientThreadPool = make_shared< CatchupClientThreadPool >(
+            num_threads( ( uint64_t ) _sChain.getNodeCount() + 1 ), this );
         catchupClientThreadPool->startService();
     }
 }
 
 
 nlohmann::json CatchupClientAgent::readCatchupResponseHeader( ptr< ClientSocket > _socket ) {
-    return sChain->getIo()->readJsonHeader( _socket->getDescriptor(), "Read catchup response" );
+    return sChain->getIo()->readJsonHeader( _socket, "Read catchup response" );
 }
 
 
 void CatchupClientAgent::sync( schain_index _dstIndex ) {
-    LOG( debug,
-        "Catchupc step 0: request for block" + to_string( getSchain()->getCommittedBlockID() ) );
+    // find out how far behind we are, the segment workers download the rest in parallel
+    auto committedBlockID = getSchain()->getCommittedBlockID();
+
+    uint64_t peerBlockID = 0;
+
+    // while the workers are downloading only the peer height is of interest
+    auto maxBlocks = scheduler->isBehind() ? 1 : getNode()->getCatchupChunkBlocks();
+
+    auto blocks = fetchBlocks( _dstIndex, committedBlockID, maxBlocks, peerBlockID );
+
+    scheduler->updatePeerBlockID( _dstIndex, peerBlockID );
+    scheduler->blocksArrived( blocks );
+}
+
+
+void CatchupClientAgent::lagDetected( schain_index _peerIndex, uint64_t _peerBlockID ) {
+    if ( catchupClientThreadPool == nullptr )
+        return;
 
-    auto header = make_shared< CatchupRequestHeader >( *sChain, _dstIndex );
-    auto socket = make_shared< ClientSocket >( *sChain, _dstIndex, CATCHUP );
+    LOG( debug, "Catchupc: peer " + to_string( _peerIndex ) + " is at block " + to_string( _peerBlockID ) );
+
+    // the segment workers pick this up immediately, the periodic sync stays as a fallback
+    scheduler->peerBlockIDHint( _peerIndex, _peerBlockID );
+}
+
+
+ptr< vector< ptr< CommittedBlock > > > CatchupClientAgent::fetchBlocks( schain_index _dstIndex,
+    block_id _blockID, uint64_t _maxBlocks, uint64_t& _peerBlockID ) {
+    LOG( debug, "Catchupc step 0: request for block" + to_string( _blockID ) );
+
+    auto header = make_shared< CatchupRequestHeader >( *sChain, _dstIndex, _blockID, _maxBlocks );
+    auto socket = getSchain()->getConnectionPool()->acquire( _dstIndex, CATCHUP );
     auto io = getSchain()->getIo();
 
 
@@ -112,9 +146,17 @@ void CatchupClientAgent::sync( schain_index _dstIndex ) {
 
     auto status = ( ConnectionStatus ) Header::getUint64( response, "status" );
 
+    // older servers do not report their committed block
+    _peerBlockID = ( uint64_t ) _blockID;
+
+    if ( response.find( "committedBlockID" ) != response.end() ) {
+        _peerBlockID = Header::getUint64( response, "committedBlockID" );
+    }
+
     if ( status == CONNECTION_DISCONNECT ) {
         LOG( debug, "Catchupc got response::no missing blocks" );
-        return;
+        getSchain()->getConnectionPool()->release( socket );
+        return make_shared< vector< ptr< CommittedBlock > > >();
     }
 
 
@@ -124,11 +166,15 @@ void CatchupClientAgent::sync( schain_index _dstIndex ) {
     }
 
 
-    ptr< CommittedBlockList > blocks;
+    ptr< vector< ptr< CommittedBlock > > > blocks;
 
 
     try {
-        blocks = readMissingBlocks( socket, response );
+        if ( response.find( "sizes" ) == response.end() ) {
+            blocks = readStreamedBlocks( socket );
+        } else {
+            blocks = readMissingBlocks( socket, response )->getBlocks();
+        }
     } catch ( ExitRequestedException& ) {
         throw;
     } catch ( ... ) {
@@ -137,12 +183,66 @@ void CatchupClientAgent::sync( schain_index _dstIndex ) {
         throw_with_nested( NetworkProtocolException( errString, __CLASS_NAME__ ) );
     }
 
-    LOG( debug, "Catchupc step 3: got missing blocks:" + to_string( blocks->getBlocks()->size() ) );
+    LOG( debug, "Catchupc step 3: got missing blocks:" + to_string( blocks->size() ) );
+
+    getSchain()->getConnectionPool()->release( socket );
+
+    if ( !blocks->empty() ) {
+        _peerBlockID = max( _peerBlockID, ( uint64_t ) blocks->back()->getBlockID() );
+    }
+
+    return blocks;
+}
+
+
+ptr< vector< ptr< CommittedBlock > > > CatchupClientAgent::readStreamedBlocks(
+    ptr< ClientSocket > _socket ) {
+    auto io = getSchain()->getIo();
+
+    uint64_t totalSize = 0;
+
+    auto blocks = make_shared< vector< ptr< CommittedBlock > > >();
+
+    while ( true ) {
+        uint64_t size = 0;
+
+        io->readBytes(
+            _socket->getDescriptor(), ( in_buffer* ) &size, msg_len( sizeof( size ) ) );
+
+        if ( size == 0 )
+            break;
+
+        totalSize += size;
+
+        if ( size <= sizeof( uint64_t ) || size > getNode()->getMaxCatchupDownloadBytes() ) {
+            BOOST_THROW_EXCEPTION( NetworkProtocolException(
+                "Invalid streamed block size:" + to_string( size ), __CLASS_NAME__ ) );
+        }
+
+        // the server only goes over the requested chunk size with a single block, as we do not
+        // apply blocks before the chunk ends this bounds what is buffered
+        if ( !blocks->empty() && totalSize > getNode()->getCatchupChunkBytes() ) {
+            BOOST_THROW_EXCEPTION( NetworkProtocolException(
+                "Streamed chunk exceeds requested size:" + to_string( totalSize ), __CLASS_NAME__ ) );
+        }
 
-    getSchain()->blockCommitsArrivedThroughCatchup( blocks );
-    LOG( debug, "Catchupc success" );
+        auto serializedBlock = make_shared< vector< uint8_t > >( size );
+
+        io->readBytes(
+            _socket->getDescriptor(), ( in_buffer* ) serializedBlock->data(), msg_len( size ) );
+
+        if ( ( *serializedBlock )[sizeof( uint64_t )] != '{' ) {
+            BOOST_THROW_EXCEPTION( NetworkProtocolException(
+                "Streamed block does not start with {", __CLASS_NAME__ ) );
+        }
+
+        blocks->push_back( make_shared< CommittedBlock >( serializedBlock ) );
+    }
+
+    return blocks;
 }
 
+
 size_t CatchupClientAgent::parseBlockSizes(
     nlohmann::json _responseHeader, ptr< vector< size_t > > _blockSizes ) {
     nlohmann::json jsonSizes = _responseHeader["sizes"];
@@ -244,6 +344,50 @@ void CatchupClientAgent::workerThreadItemSendLoop( CatchupClientAgent* agent ) {
     }
 }
 
+void CatchupClientAgent::workerThreadSegmentFetchLoop( CatchupClientAgent* agent ) {
+    setThreadName( __CLASS_NAME__ );
+
+    auto peer = schain_index( agent->threadCounter++ );
+
+    if ( peer == agent->getSchain()->getSchainIndex() )
+        return;
+
+    agent->waitOnGlobalStartBarrier();
+
+    try {
+        while ( !agent->getSchain()->getNode()->isExitRequested() ) {
+            uint64_t start = 0;
+            uint64_t count = 0;
+
+            if ( !agent->getScheduler()->nextSegment( peer, start, count, 1000 ) )
+                continue;
+
+            auto beginMs = Schain::getCurrentTimeMs();
+
+            try {
+                uint64_t peerBlockID = 0;
+                auto blocks = agent->fetchBlocks( peer, block_id( start - 1 ), count, peerBlockID );
+                agent->getScheduler()->updatePeerBlockID( peer, peerBlockID );
+                agent->getScheduler()->segmentArrived(
+                    peer, start, count, blocks, Schain::getCurrentTimeMs() - beginMs );
+            } catch ( ExitRequestedException& ) {
+                return;
+            } catch ( Exception& e ) {
+                agent->getScheduler()->segmentFailed( peer, start );
+                Exception::log_exception( e );
+            }
+        };
+    } catch ( FatalError* e ) {
+        agent->getNode()->exitOnFatalError( e->getMessage() );
+    }
+}
+
+
+const ptr< CatchupSegmentScheduler >& CatchupClientAgent::getScheduler() const {
+    return scheduler;
+}
+
+
 schain_index CatchupClientAgent::nextSyncNodeIndex(
     const CatchupClientAgent* agent, schain_index _destinationSubChainIndex ) {
     auto nodeCount = ( uint64_t ) agent->getSchain()->getNodeCount();
@@ -26,7 +26,9 @@
 
 
 
+class CommittedBlock;
 class CommittedBlockList;
+class CatchupSegmentScheduler;
 class ClientSocket;
 class Schain;
 class CatchupClientThreadPool;
@@ -43,15 +45,28 @@ public:
 
     ptr<CatchupClientThreadPool> catchupClientThreadPool = nullptr;
 
+    ptr<CatchupSegmentScheduler> scheduler = nullptr;
+
 
     CatchupClientAgent(Schain& subChain_);
 
 
     void sync(schain_index _dstIndex);
 
+    void lagDetected(schain_index _peerIndex, uint64_t _peerBlockID);
+
+    ptr<vector<ptr<CommittedBlock>>> fetchBlocks(schain_index _dstIndex, block_id _blockID, uint64_t _maxBlocks,
+                                                 uint64_t &_peerBlockID);
+
+    ptr<vector<ptr<CommittedBlock>>> readStreamedBlocks(ptr<ClientSocket> _socket);
+
 
     static void workerThreadItemSendLoop(CatchupClientAgent *agent);
 
+    static void workerThreadSegmentFetchLoop(CatchupClientAgent *agent);
+
+    const ptr<CatchupSegmentScheduler> &getScheduler() const;
+
     nlohmann::json readCatchupResponseHeader(ptr<ClientSocket> _socket);
 
 
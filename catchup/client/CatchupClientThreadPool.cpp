@@ -41,13 +41,16 @@ CatchupClientThreadPool::CatchupClientThreadPool(num_threads numThreads, void *p
 }
 
 
-void CatchupClientThreadPool::createThread(uint64_t /*number*/) {
+void CatchupClientThreadPool::createThread(uint64_t number) {
 
     auto p = (CatchupClientAgent*)params;
 
 
-
-    this->threadpool.push_back(make_shared<thread>(CatchupClientAgent::workerThreadItemSendLoop, p));
+    if (number + 1 < (uint64_t) numThreads) {
+        this->threadpool.push_back(make_shared<thread>(CatchupClientAgent::workerThreadSegmentFetchLoop, p));
+    } else {
+        this->threadpool.push_back(make_shared<thread>(CatchupClientAgent::workerThreadItemSendLoop, p));
+    }
 
 }
 
@@ -0,0 +1,352 @@
+/*
+    Copyright (C) 2018-2019 SKALE Labs
+
+    This file is part of skale-consensus.
+
+    skale-consensus is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    skale-consensus is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with skale-consensus.  If not, see <http://www.gnu.org/licenses/>.
+
+    @file CatchupSegmentScheduler.cpp
+    @author Stan Kladko
+    @date 2018
+*/
+
+
+#include "../../SkaleConfig.h"
+#include "../../Log.h"
+#include "../../exceptions/FatalError.h"
+
+#include "../../thirdparty/json.hpp"
+#include "../../chains/Schain.h"
+#include "../../node/Node.h"
+#include "../../datastructures/CommittedBlock.h"
+#include "../../datastructures/CommittedBlockList.h"
+
+#include "CatchupSegmentScheduler.h"
+
+
+CatchupSegmentScheduler::CatchupSegmentScheduler(Schain &_sChain) : sChain(_sChain) {}
+
+
+uint64_t CatchupSegmentScheduler::getSegmentSize(schain_index _peer) {
+
+    auto chunk = sChain.getNode()->getCatchupChunkBlocks();
+
+    double fastest = 0;
+
+    for (auto &&item : peers) {
+        fastest = max(fastest, item.second.blocksPerSecond);
+    }
+
+    auto &stats = peers[_peer];
+
+    // peers that were not measured yet get a full chunk
+    if (fastest == 0 || stats.blocksPerSecond == 0)
+        return chunk;
+
+    return max((uint64_t) (chunk * stats.blocksPerSecond / fastest), (uint64_t) 1);
+}
+
+
+uint64_t CatchupSegmentScheduler::getWindowBlocks() {
+    return sChain.getNode()->getCatchupChunkBlocks() * CATCHUP_SEGMENTS_AHEAD_PER_PEER *
+           (uint64_t) sChain.getNodeCount();
+}
+
+
+bool CatchupSegmentScheduler::assignSegment(schain_index _peer, uint64_t &_start, uint64_t &_count) {
+
+    auto committedBlockID = (uint64_t) sChain.getCommittedBlockID();
+
+    auto now = Schain::getCurrentTimeMs();
+
+    auto &stats = peers[_peer];
+
+    if (stats.nextAttemptMs > now)
+        return false;
+
+    auto peerHeight = stats.heightKnown ? stats.height : targetBlockID;
+
+    nextBlockID = max(nextBlockID, committedBlockID + 1);
+
+    while (!returnedSegments.empty() && returnedSegments.begin()->second <= committedBlockID) {
+        returnedSegments.erase(returnedSegments.begin());
+    }
+
+    // segments given up by other peers go first
+
+    for (auto it = returnedSegments.begin(); it != returnedSegments.end(); it++) {
+        auto start = max(it->first, committedBlockID + 1);
+        if (start > peerHeight)
+            continue;
+        auto end = min(it->second, peerHeight);
+        auto returnedEnd = it->second;
+        returnedSegments.erase(it);
+        if (end < returnedEnd) {
+            returnedSegments[end + 1] = returnedEnd;
+        }
+        _start = start;
+        _count = end - start + 1;
+        auto &segment = inFlight[start];
+        segment.start = start;
+        segment.end = end;
+        segment.assignedMs = now;
+        segment.peers.insert(_peer);
+        return true;
+    }
+
+    auto last = min(targetBlockID, peerHeight);
+
+    if (nextBlockID <= last && nextBlockID <= committedBlockID + getWindowBlocks()) {
+        auto start = nextBlockID;
+        auto end = min(start + getSegmentSize(_peer) - 1, last);
+        nextBlockID = end + 1;
+        _start = start;
+        _count = end - start + 1;
+        auto &segment = inFlight[start];
+        segment.start = start;
+        segment.end = end;
+        segment.assignedMs = now;
+        segment.peers.insert(_peer);
+        return true;
+    }
+
+    // the segment everything else waits for is overdue, ask this peer as well
+
+    if (!inFlight.empty()) {
+        auto &segment = inFlight.begin()->second;
+        if (segment.start <= committedBlockID + 1 && segment.end <= peerHeight &&
+            segment.peers.count(_peer) == 0 && now - segment.assignedMs > CATCHUP_SEGMENT_TIMEOUT_MS) {
+            LOG(debug, "Catchup: requesting overdue segment " + to_string(segment.start) + " from another peer");
+            segment.peers.insert(_peer);
+            segment.assignedMs = now;
+            _start = segment.start;
+            _count = segment.end - segment.start + 1;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+void CatchupSegmentScheduler::updateTargetBlockID() {
+
+    // peers that fell behind or lost blocks must not keep the node in catchup mode
+    targetBlockID = 0;
+
+    for (auto &&item : peers) {
+        if (item.second.heightKnown) {
+            targetBlockID = max(targetBlockID, item.second.height);
+        }
+    }
+}
+
+
+void CatchupSegmentScheduler::updatePeerBlockID(schain_index _peer, uint64_t _blockID) {
+    {
+        lock_guard<mutex> lock(schedulerMutex);
+
+        auto &stats = peers[_peer];
+        stats.heightKnown = true;
+        stats.height = _blockID;
+
+        updateTargetBlockID();
+    }
+
+    schedulerCond.notify_all();
+}
+
+
+void CatchupSegmentScheduler::peerBlockIDHint(schain_index _peer, uint64_t _blockID) {
+    {
+        lock_guard<mutex> lock(schedulerMutex);
+
+        auto &stats = peers[_peer];
+
+        if (stats.heightKnown && stats.height >= _blockID)
+            return;
+
+        stats.heightKnown = true;
+        stats.height = _blockID;
+
+        // the peer has proven to be reachable and ahead, do not wait for the backoff
+        stats.nextAttemptMs = 0;
+
+        updateTargetBlockID();
+    }
+
+    schedulerCond.notify_all();
+}
+
+
+bool CatchupSegmentScheduler::nextSegment(schain_index _peer, uint64_t &_start, uint64_t &_count,
+                                          uint64_t _timeoutMs) {
+
+    unique_lock<mutex> lock(schedulerMutex);
+
+    if (assignSegment(_peer, _start, _count))
+        return true;
+
+    schedulerCond.wait_for(lock, chrono::milliseconds(_timeoutMs));
+
+    return assignSegment(_peer, _start, _count);
+}
+
+
+void CatchupSegmentScheduler::segmentArrived(schain_index _peer, uint64_t _start, uint64_t _count,
+                                             ptr<vector<ptr<CommittedBlock>>> _blocks, uint64_t _elapsedMs) {
+
+    ASSERT(_blocks);
+
+    {
+        lock_guard<mutex> lock(schedulerMutex);
+
+        auto &stats = peers[_peer];
+
+        double blocksPerSecond = _blocks->size() * 1000.0 / max(_elapsedMs, (uint64_t) 1);
+
+        if (stats.blocksPerSecond == 0) {
+            stats.blocksPerSecond = blocksPerSecond;
+        } else {
+            stats.blocksPerSecond = 0.7 * stats.blocksPerSecond + 0.3 * blocksPerSecond;
+        }
+
+        stats.failures = 0;
+
+        auto received = (uint64_t) _blocks->size();
+
+        if (received == 0 || (*_blocks)[0]->getBlockID() != _start) {
+            received = 0;
+        }
+
+        if (received == 0) {
+            // the peer does not have the segment, a partial segment may just be capped by size
+            stats.height = stats.heightKnown ? min(stats.height, _start - 1) : _start - 1;
+            stats.heightKnown = true;
+            updateTargetBlockID();
+        }
+
+        auto it = inFlight.find(_start);
+
+        // a segment that was also requested from another peer is completed by whoever comes first
+        if (it != inFlight.end()) {
+            if (received < _count) {
+                returnedSegments[_start + received] = it->second.end;
+            }
+            inFlight.erase(it);
+        }
+
+        if (received > 0) {
+            arrivedSegments[_start] = _blocks;
+        }
+    }
+
+    schedulerCond.notify_all();
+
+    deliver();
+}
+
+
+void CatchupSegmentScheduler::segmentFailed(schain_index _peer, uint64_t _start) {
+    {
+        lock_guard<mutex> lock(schedulerMutex);
+
+        auto &stats = peers[_peer];
+
+        auto backoff = sChain.getNode()->getWaitAfterNetworkErrorMs() << min(stats.failures, (uint64_t) 16);
+
+        stats.failures++;
+        stats.nextAttemptMs = Schain::getCurrentTimeMs() + min(backoff, MAX_RECONNECT_BACKOFF_MS);
+        stats.blocksPerSecond = stats.blocksPerSecond / 2;
+
+        auto it = inFlight.find(_start);
+
+        if (it != inFlight.end()) {
+            it->second.peers.erase(_peer);
+            if (it->second.peers.empty()) {
+                returnedSegments[it->second.start] = it->second.end;
+                inFlight.erase(it);
+            }
+        }
+    }
+
+    schedulerCond.notify_all();
+}
+
+
+void CatchupSegmentScheduler::blocksArrived(ptr<vector<ptr<CommittedBlock>>> _blocks) {
+
+    ASSERT(_blocks);
+
+    if (_blocks->empty())
+        return;
+
+    {
+        lock_guard<mutex> lock(schedulerMutex);
+        auto start = (uint64_t) (*_blocks)[0]->getBlockID();
+        if (arrivedSegments.count(start) == 0 || arrivedSegments[start]->size() < _blocks->size()) {
+            arrivedSegments[start] = _blocks;
+        }
+    }
+
+    deliver();
+}
+
+
+void CatchupSegmentScheduler::deliver() {
+
+    lock_guard<mutex> deliveryLock(deliveryMutex);
+
+    bool applied = false;
+
+    while (true) {
+
+        ptr<vector<ptr<CommittedBlock>>> blocks = nullptr;
+
+        {
+            lock_guard<mutex> lock(schedulerMutex);
+
+            auto committedBlockID = (uint64_t) sChain.getCommittedBlockID();
+
+            while (!arrivedSegments.empty()) {
+                auto first = arrivedSegments.begin();
+                if (first->second->back()->getBlockID() > committedBlockID)
+                    break;
+                arrivedSegments.erase(first);
+            }
+
+            if (arrivedSegments.empty() || arrivedSegments.begin()->first > committedBlockID + 1)
+                break;
+
+            blocks = arrivedSegments.begin()->second;
+            arrivedSegments.erase(arrivedSegments.begin());
+        }
+
+        if (sChain.applyBlocksArrivedThroughCatchup(make_shared<CommittedBlockList>(blocks))) {
+            applied = true;
+        }
+    }
+
+    schedulerCond.notify_all();
+
+    if (applied && !isBehind()) {
+        sChain.proposeNextBlockAfterCatchup();
+    }
+}
+
+
+bool CatchupSegmentScheduler::isBehind() {
+    lock_guard<mutex> lock(schedulerMutex);
+    return targetBlockID > (uint64_t) sChain.getCommittedBlockID();
+}
@@ -0,0 +1,126 @@
+/*
+    Copyright (C) 2018-2019 SKALE Labs
+
+    This file is part of skale-consensus.
+
+    skale-consensus is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    skale-consensus is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with skale-consensus.  If not, see <http://www.gnu.org/licenses/>.
+
+    @file CatchupSegmentScheduler.h
+    @author Stan Kladko
+    @date 2018
+*/
+
+
+#pragma once
+
+
+class Schain;
+class CommittedBlock;
+
+
+/**
+ * Splits the range of missing blocks into segments that are downloaded from several peers at once.
+ * Faster peers get larger segments, segments of failed peers are handed to other peers and the
+ * segment that blocks in-order delivery is also requested from an idle peer once it is overdue.
+ * Downloaded segments are committed strictly in block order.
+ */
+class CatchupSegmentScheduler {
+
+    class Segment {
+    public:
+        uint64_t start = 0;
+
+        uint64_t end = 0;
+
+        uint64_t assignedMs = 0;
+
+        set<schain_index> peers;
+    };
+
+    class PeerStats {
+    public:
+        double blocksPerSecond = 0;
+
+        bool heightKnown = false;
+
+        uint64_t height = 0;
+
+        uint64_t failures = 0;
+
+        uint64_t nextAttemptMs = 0;
+    };
+
+    Schain &sChain;
+
+    mutex schedulerMutex;
+
+    condition_variable schedulerCond;
+
+    // only one thread commits downloaded blocks at a time
+    mutex deliveryMutex;
+
+    uint64_t targetBlockID = 0;
+
+    // first block that has not been assigned to any peer yet
+    uint64_t nextBlockID = 0;
+
+    map<uint64_t, Segment> inFlight;
+
+    map<uint64_t, uint64_t> returnedSegments;
+
+    map<uint64_t, ptr<vector<ptr<CommittedBlock>>>> arrivedSegments;
+
+    map<schain_index, PeerStats> peers;
+
+    uint64_t getSegmentSize(schain_index _peer);
+
+    uint64_t getWindowBlocks();
+
+    void updateTargetBlockID();
+
+    bool assignSegment(schain_index _peer, uint64_t &_start, uint64_t &_count);
+
+    void deliver();
+
+public:
+
+    explicit CatchupSegmentScheduler(Schain &_sChain);
+
+    /**
+     * Records the last committed block reported by a peer, this extends the range to download
+     */
+    void updatePeerBlockID(schain_index _peer, uint64_t _blockID);
+
+    /**
+     * Records that a peer committed at least _blockID, e.g. because it voted on the next block
+     */
+    void peerBlockIDHint(schain_index _peer, uint64_t _blockID);
+
+    /**
+     * Waits up to _timeoutMs for a segment for the peer to download
+     */
+    bool nextSegment(schain_index _peer, uint64_t &_start, uint64_t &_count, uint64_t _timeoutMs);
+
+    void segmentArrived(schain_index _peer, uint64_t _start, uint64_t _count,
+                        ptr<vector<ptr<CommittedBlock>>> _blocks, uint64_t _elapsedMs);
+
+    void segmentFailed(schain_index _peer, uint64_t _start);
+
+    /**
+     * Blocks downloaded outside of a segment, e.g. by the periodic catchup
+     */
+    void blocksArrived(ptr<vector<ptr<CommittedBlock>>> _blocks);
+
+    bool isBehind();
+};
@@ -48,6 +48,7 @@
 #include "../../pendingqueue/PendingTransactionsAgent.h"
 
 #include "../../chains/Schain.h"
+#include "../../db/StorageAgent.h"
 #include "../../network/TransportNetwork.h"
 #include "../../network/Sockets.h"
 #include "../../network/Connection.h"
@@ -58,6 +59,7 @@
 
 #include "../../datastructures/CommittedBlock.h"
 #include "../../datastructures/CommittedBlockList.h"
+#include "../../db/BlockLog.h"
 #include "CatchupServerAgent.h"
 
 
@@ -68,7 +70,7 @@ CatchupWorkerThreadPool *CatchupServerAgent::getCatchupWorkerThreadPool() const
 
 CatchupServerAgent::CatchupServerAgent(Schain &_schain, ptr<TCPServerSocket> _s) : AbstractServerAgent(
         "Block proposal server", _schain, _s) {
-    catchupWorkerThreadPool = make_shared<CatchupWorkerThreadPool>(num_threads(1), this);
+    catchupWorkerThreadPool = make_shared<CatchupWorkerThreadPool>(num_threads((uint64_t) _schain.getNodeCount() * MAX_SERVER_WORKERS_PER_PEER), this);
     catchupWorkerThreadPool->startService();
     createNetworkReadThread();
 }
@@ -82,7 +84,7 @@ void CatchupServerAgent::processNextAvailableConnection(ptr<Connection> _connect
 
 
     try {
-        sChain->getIo()->readMagic(_connection->getDescriptor());
+        sChain->getIo()->readMagic(_connection);
     }
     catch (PingException &) { return; }
     catch (ExitRequestedException &) { throw; }
@@ -137,6 +139,13 @@ void CatchupServerAgent::processNextAvailableConnection(ptr<Connection> _connect
     LOG(debug, "Server step 2: sent catchup response header");
 
 
+    if (isStreamingRequest(catchupRequest)) {
+        if (responseHeader->getStatus() == CONNECTION_PROCEED) {
+            streamBlocks(_connection, catchupRequest);
+        }
+        return;
+    }
+
     if (serializedBlocks == nullptr) {
         LOG(debug, "Server step 3: response completed: no missing blocks");
         return;
@@ -202,6 +211,8 @@ ptr<vector<uint8_t>> CatchupServerAgent::createCatchupResponseHeader(ptr<Connect
     }
 
 
+    _responseHeader->setCommittedBlockID((uint64_t) sChain->getCommittedBlockID());
+
     if (sChain->getCommittedBlockID() <= block_id(blockID)) {
         LOG(debug, "Catchups: sChain->getCommittedBlockID() <= block_id(blockID)");
         _responseHeader->setStatusSubStatus(CONNECTION_DISCONNECT, CONNECTION_NO_NEW_BLOCKS);
@@ -220,24 +231,30 @@ ptr<vector<uint8_t>> CatchupServerAgent::createCatchupResponseHeader(ptr<Connect
         return nullptr;
     }
 
-    auto serializedBlocks = make_shared<vector<uint8_t>>();
+    if (isStreamingRequest(_jsonRequest)) {
+        // the blocks follow the header, each one prefixed with its size
+        _responseHeader->setStatus(CONNECTION_PROCEED);
+        _responseHeader->setBlockCount(min((uint64_t) committedBlockID - (uint64_t) blockID, getMaxBlocks(_jsonRequest)));
+        _responseHeader->setComplete();
+        return nullptr;
+    }
 
+    auto serializedBlocks = make_shared<vector<uint8_t>>();
 
+    // older clients get a buffered response, bounded the same way as a streamed one
+    auto lastBlockID = min((uint64_t) committedBlockID, (uint64_t) blockID + getMaxBlocks(_jsonRequest));
 
-    for (uint64_t i = (uint64_t) blockID + 1; i <= committedBlockID; i++) {
+    auto blockList = getSerializedBlocks((uint64_t) blockID + 1, lastBlockID, getNode()->getCatchupChunkBytes());
 
-        auto serializedBlock = getSerializedBlock(i);
-
-        if (!serializedBlock) {
-            _responseHeader->setStatus(CONNECTION_DISCONNECT);
-            _responseHeader->setComplete();
-            return nullptr;
-        }
+    if (blockList->empty()) {
+        _responseHeader->setStatus(CONNECTION_DISCONNECT);
+        _responseHeader->setComplete();
+        return nullptr;
+    }
 
+    for (auto &&serializedBlock : *blockList) {
         serializedBlocks->insert(serializedBlocks->end(), serializedBlock->begin(), serializedBlock->end());
-
         blockSizes->push_back(serializedBlock->size());
-
     }
 
     _responseHeader->setStatus(CONNECTION_PROCEED);
@@ -252,6 +269,124 @@ ptr<vector<uint8_t>> CatchupServerAgent::createCatchupResponseHeader(ptr<Connect
 
 }
 
+bool CatchupServerAgent::isStreamingRequest(nlohmann::json &_jsonRequest) {
+    return _jsonRequest.find("maxBlocks") != _jsonRequest.end();
+}
+
+
+uint64_t CatchupServerAgent::getMaxBlocks(nlohmann::json &_jsonRequest) {
+
+    auto maxBlocks = getNode()->getCatchupChunkBlocks();
+
+    if (isStreamingRequest(_jsonRequest)) {
+        maxBlocks = min(maxBlocks, Header::getUint64(_jsonRequest, "maxBlocks"));
+    }
+
+    return max(maxBlocks, (uint64_t) 1);
+}
+
+
+class BlockStreamer : public Schain::SerializedBlockVisitor {
+
+    CatchupServerAgent *agent;
+
+    ptr<Connection> connection;
+
+public:
+
+    BlockStreamer(CatchupServerAgent *_agent, ptr<Connection> _connection) :
+            agent(_agent), connection(_connection) {}
+
+    void visitSerializedBlock(const uint8_t *_data, uint64_t _size) override {
+        agent->sendStreamedBlock(connection, _data, _size);
+    }
+};
+
+
+void CatchupServerAgent::streamBlocks(ptr<Connection> _connection, nlohmann::json &_jsonRequest) {
+
+    block_id blockID = Header::getUint64(_jsonRequest, "blockID");
+
+    auto maxBlocks = getMaxBlocks(_jsonRequest);
+    auto maxBytes = min(getNode()->getCatchupChunkBytes(), Header::getUint64(_jsonRequest, "maxBytes"));
+
+    auto committedBlockID = sChain->getCommittedBlockID();
+
+    auto lastBlockID = min((uint64_t) committedBlockID, (uint64_t) blockID + maxBlocks);
+
+    // the stream is read from storage, the newest committed blocks may still be queued for the disk
+    if (!sChain->getStorageAgent()->waitUntilPersisted(block_id(lastBlockID), CATCHUP_PERSIST_WAIT_MS)) {
+        LOG(debug, "Streaming catchup blocks up to persisted block only");
+    }
+
+    BlockStreamer streamer(this, _connection);
+
+    auto sentBlocks = sChain->visitSerializedBlocksFromStorage((uint64_t) blockID + 1, lastBlockID, maxBytes, &streamer);
+
+    uint64_t end = 0;
+
+    try {
+        getSchain()->getIo()->writeBytes(_connection->getDescriptor(), (out_buffer *) &end, msg_len(sizeof(end)));
+    } catch (ExitRequestedException &) {
+        throw;
+    } catch (...) {
+        throw_with_nested(CouldNotSendMessageException("Could not end block stream", __CLASS_NAME__));
+    }
+
+    LOG(debug, "Server step 3: streamed blocks:" + to_string(sentBlocks));
+}
+
+
+void CatchupServerAgent::sendStreamedBlock(ptr<Connection> _connection, const uint8_t *_data, uint64_t _size) {
+
+    // every block is preceded by its size, a zero size ends the stream
+
+    try {
+        getSchain()->getIo()->writeBytes(_connection->getDescriptor(), (out_buffer *) &_size, msg_len(sizeof(_size)));
+        getSchain()->getIo()->writeBytes(_connection->getDescriptor(), (out_buffer *) _data, msg_len(_size));
+    } catch (ExitRequestedException &) {
+        throw;
+    } catch (...) {
+        throw_with_nested(CouldNotSendMessageException("Could not send block", __CLASS_NAME__));
+    }
+}
+
+
+ptr<vector<ptr<vector<uint8_t>>>> CatchupServerAgent::getSerializedBlocks(uint64_t _firstBlockID,
+                                                                         uint64_t _lastBlockID,
+                                                                         uint64_t _maxBytes) {
+
+    auto result = make_shared<vector<ptr<vector<uint8_t>>>>();
+
+    if (_firstBlockID > _lastBlockID)
+        return result;
+
+    // recent blocks are usually cached, older ones are read sequentially from storage
+
+    if (sChain->getCachedBlock(_firstBlockID) == nullptr) {
+        return sChain->getSerializedBlocksFromStorage(_firstBlockID, _lastBlockID, _maxBytes);
+    }
+
+    uint64_t totalSize = 0;
+
+    for (auto i = _firstBlockID; i <= _lastBlockID; i++) {
+
+        auto serializedBlock = getSerializedBlock(i);
+
+        if (!serializedBlock)
+            break;
+
+        if (!result->empty() && totalSize + serializedBlock->size() > _maxBytes)
+            break;
+
+        result->push_back(serializedBlock);
+        totalSize += serializedBlock->size();
+    }
+
+    return result;
+}
+
+
 ptr<vector<uint8_t>> CatchupServerAgent::getSerializedBlock(uint64_t i) const {
 
 
@@ -261,7 +396,7 @@ ptr<vector<uint8_t>> CatchupServerAgent::getSerializedBlock(uint64_t i) const {
     if (block) {
         return block->serialize();
     } else {
-        return sChain->getSerializedBlockFromLevelDB(i);
+        return sChain->getSerializedBlockFromStorage(i);
     }
 
 }
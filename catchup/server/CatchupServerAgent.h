@@ -62,4 +62,21 @@ public:
     void processNextAvailableConnection(ptr<Connection> _connection) override;
 
     ptr<vector<uint8_t>> getSerializedBlock(uint64_t i) const;
+
+    /**
+     * Consecutive blocks starting at _firstBlockID, limited by _maxBytes, the first block is always included
+     */
+    ptr<vector<ptr<vector<uint8_t>>>> getSerializedBlocks(uint64_t _firstBlockID, uint64_t _lastBlockID,
+                                                          uint64_t _maxBytes);
+
+    /**
+     * Clients that send a chunk limit read the blocks as a stream of size-prefixed blocks
+     */
+    static bool isStreamingRequest(nlohmann::json &_jsonRequest);
+
+    uint64_t getMaxBlocks(nlohmann::json &_jsonRequest);
+
+    void streamBlocks(ptr<Connection> _connection, nlohmann::json &_jsonRequest);
+
+    void sendStreamedBlock(ptr<Connection> _connection, const uint8_t *_data, uint64_t _size);
 };
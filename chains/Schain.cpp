@@ -62,10 +62,12 @@
 #include "../network/Sockets.h"
 
 #include "../network/ClientSocket.h"
+#include "../network/ClientConnectionPool.h"
 #include "../network/ZMQServerSocket.h"
 #include "SchainMessageThreadPool.h"
 #include "../pendingqueue/ExternalQueueSyncAgent.h"
 #include "../network/IO.h"
+#include "../network/TransportNetwork.h"
 
 #include "../crypto/SHAHash.h"
 #include "../exceptions/ExitRequestedException.h"
@@ -87,6 +89,8 @@
 #include "../pendingqueue/TestMessageGeneratorAgent.h"
 #include "../crypto/bls_include.h"
 #include "../db/LevelDB.h"
+#include "../db/BlockLog.h"
+#include "../db/StorageAgent.h"
 
 
 #include "Schain.h"
@@ -94,21 +98,29 @@
 
 void Schain::postMessage(ptr<MessageEnvelope> m) {
 
-
-    lock_guard<mutex> lock(messageMutex);
-
     ASSERT(m);
     ASSERT((uint64_t) m->getMessage()->getBlockId() != 0);
 
+    messageInboxes.at((uint64_t) m->getMessage()->getBlockProposerIndex() % messageInboxes.size())->push(m);
+}
+
+
+void Schain::notifyAllConditionVariables() {
+
+    Agent::notifyAllConditionVariables();
 
-    messageQueue.push(m);
-    messageCond.notify_all();
+    for (auto &&inbox : messageInboxes) {
+        inbox->wakeup();
+    }
 }
 
 
-void Schain::messageThreadProcessingLoop(Schain *s) {
+void Schain::messageThreadProcessingLoop(Schain *s, uint64_t _threadNumber) {
 
     ASSERT(s);
+    ASSERT(_threadNumber < s->messageInboxes.size());
+
+    auto inbox = s->messageInboxes[_threadNumber];
 
     setThreadName(__CLASS_NAME__);
     s->waitOnGlobalStartBarrier();
@@ -125,34 +137,19 @@ void Schain::messageThreadProcessingLoop(Schain *s) {
 
         logThreadLocal_ = s->getNode()->getLog();
 
-        queue<ptr<MessageEnvelope>> newQueue;
+        vector<ptr<MessageEnvelope>> newMessages;
 
         while (!s->getNode()->isExitRequested()) {
 
-            {
-                unique_lock<mutex> mlock(s->messageMutex);
-                while (s->messageQueue.empty()) {
-                    s->messageCond.wait(mlock);
-                    if (s->getNode()->isExitRequested()) {
-                        s->getNode()->getSockets()->consensusZMQSocket->closeSend();
-                        return;
-                    }
-                }
-
-                newQueue = s->messageQueue;
-
+            newMessages.clear();
 
-                while (!s->messageQueue.empty()) {
-
-                    s->messageQueue.pop();
-                }
+            if (inbox->drain(newMessages) == 0) {
+                inbox->wait(1000);
+                continue;
             }
 
 
-            while (!newQueue.empty()) {
-
-                ptr<MessageEnvelope> m = newQueue.front();
-
+            for (auto &&m : newMessages) {
 
                 ASSERT((uint64_t) m->getMessage()->getBlockId() != 0);
 
@@ -161,18 +158,13 @@ void Schain::messageThreadProcessingLoop(Schain *s) {
                     s->getBlockConsensusInstance()->routeAndProcessMessage(m);
                 } catch (Exception &e) {
                     if (s->getNode()->isExitRequested()) {
-                        s->getNode()->getSockets()->consensusZMQSocket->closeSend();
                         return;
                     }
                     Exception::log_exception(e);
                 }
-
-                newQueue.pop();
             }
         }
 
-
-        s->getNode()->getSockets()->consensusZMQSocket->closeSend();
     } catch (FatalError *e) {
         s->getNode()->exitOnFatalError(e->getMessage());
     }
@@ -205,28 +197,47 @@ uint64_t Schain::getCurrentTimeSec() {
 }
 
 
+uint64_t Schain::getCurrentTimeMs() {
+    uint64_t result = chrono::duration_cast<chrono::milliseconds>(
+            chrono::system_clock::now().time_since_epoch()).count();
+
+    ASSERT(result < ((uint64_t) MODERN_TIME + 1000000000) * 1000);
+
+    return result;
+}
+
+
 void Schain::startThreads() {
 
     this->consensusMessageThreadPool->startService();
 
+    this->storageAgent->startThread();
+
 
 }
 
 
 Schain::Schain(Node &_node, schain_index _schainIndex, const schain_id &_schainID, ConsensusExtFace *_extFace)
         : Agent(*this, true, true), totalTransactions(0),
-          extFace(_extFace), schainID(_schainID), consensusMessageThreadPool(new SchainMessageThreadPool(this)),
+          extFace(_extFace), schainID(_schainID), consensusMessageThreadPool(new SchainMessageThreadPool(this, num_threads(_node.getConsensusThreads()))),
           node(_node),
           schainIndex(_schainIndex) {
 
 
+    for (uint64_t i = 0; i < _node.getConsensusThreads(); i++) {
+        messageInboxes.push_back(make_shared<MPSCQueue<ptr<MessageEnvelope>>>());
+    }
+
     committedBlockID.store(0);
     bootstrapBlockID.store(0);
     committedBlockTimeStamp.store(0);
+    committedBlockTimeStampMs.store(0);
 
 
     this->io = make_shared<IO>(this);
 
+    this->connectionPool = make_shared<ClientConnectionPool>(*this);
+
 
     ASSERT(getNode()->getNodeInfosByIndex().size() > 0);
 
@@ -264,12 +275,17 @@ const ptr<IO> &Schain::getIo() const {
     return io;
 }
 
+const ptr<ClientConnectionPool> &Schain::getConnectionPool() const {
+    return connectionPool;
+}
+
 
 void Schain::constructChildAgents() {
 
     std::lock_guard<std::recursive_mutex> aLock(getMainMutex());
 
 
+    storageAgent = make_shared<StorageAgent>(*this);
     pendingTransactionsAgent = make_shared<PendingTransactionsAgent>(*this);
     blockProposalClient = make_shared<BlockProposalClientAgent>(*this);
     blockFinalizeClient =  make_shared<BlockFinalizeClientAgent>(*this);
@@ -282,7 +298,8 @@ void Schain::constructChildAgents() {
     testMessageGeneratorAgent = make_shared<TestMessageGeneratorAgent>(*this);
 
 
-    if (extFace) {
+    // push ingestion hosts call ConsensusEngine::submitTransactions, nothing is polled
+    if (extFace && !extFace->usesPushIngestion()) {
         externalQueueSyncAgent = make_shared<ExternalQueueSyncAgent>(*this, extFace);
     }
 
@@ -292,6 +309,16 @@ void Schain::constructChildAgents() {
 
 void Schain::blockCommitsArrivedThroughCatchup(ptr<CommittedBlockList> _blocks) {
 
+    std::lock_guard<std::recursive_mutex> aLock(getMainMutex());
+
+    if (applyBlocksArrivedThroughCatchup(_blocks)) {
+        proposeNextBlockAfterCatchup();
+    }
+}
+
+
+bool Schain::applyBlocksArrivedThroughCatchup(ptr<CommittedBlockList> _blocks) {
+
     ASSERT(_blocks);
 
     auto b = _blocks->getBlocks();
@@ -299,7 +326,7 @@ void Schain::blockCommitsArrivedThroughCatchup(ptr<CommittedBlockList> _blocks)
     ASSERT(b);
 
     if (b->size() == 0) {
-        return;
+        return false;
     }
 
 
@@ -308,8 +335,6 @@ void Schain::blockCommitsArrivedThroughCatchup(ptr<CommittedBlockList> _blocks)
 
     atomic<uint64_t> committedIDOld(committedBlockID.load());
 
-    uint64_t previosBlockTimeStamp = 0;
-
 
     ASSERT((*b)[0]->getBlockID() <= (uint64_t) committedBlockID + 1);
 
@@ -317,23 +342,52 @@ void Schain::blockCommitsArrivedThroughCatchup(ptr<CommittedBlockList> _blocks)
         if ((*b)[i]->getBlockID() > committedBlockID.load()) {
             committedBlockID++;
             processCommittedBlock((*b)[i]);
-            previosBlockTimeStamp = (*b)[i]->getTimeStamp();
+            committedBlockTimeStamp = (*b)[i]->getTimeStamp();
+            committedBlockTimeStampMs = (*b)[i]->getTimeStampMs();
         }
     }
 
     if (committedIDOld < committedBlockID) {
-        LOG(info, "Successful catchup, proposing next block)");
-        proposeNextBlock(previosBlockTimeStamp);
+        getNode()->getNetwork()->releaseDeferredMessages(committedBlockID + 1);
+        return true;
     }
+
+    return false;
+}
+
+
+void Schain::proposeNextBlockAfterCatchup() {
+
+    std::lock_guard<std::recursive_mutex> aLock(getMainMutex());
+
+    // consensus may have committed and proposed in the meantime
+    if (pushedBlockProposals.count(committedBlockID + 1) > 0)
+        return;
+
+    LOG(info, "Successful catchup, proposing next block)");
+    proposeNextBlock(committedBlockTimeStamp, committedBlockTimeStampMs);
+}
+
+
+void Schain::lagDetected(schain_index _peerIndex, uint64_t _peerBlockID) {
+
+    if (_peerBlockID <= (uint64_t) getCommittedBlockID())
+        return;
+
+    if (catchupClientAgent == nullptr)
+        return;
+
+    catchupClientAgent->lagDetected(_peerIndex, _peerBlockID);
 }
 
 
 void Schain::blockCommitArrived(bool bootstrap, block_id _committedBlockID, schain_index _proposerIndex,
-                                uint64_t _committedTimeStamp) {
+                                uint64_t _committedTimeStamp, uint32_t _committedTimeStampMs) {
 
     std::lock_guard<std::recursive_mutex> aLock(getMainMutex());
 
     ASSERT(_committedTimeStamp < (uint64_t) 2 * MODERN_TIME);
+    ASSERT(_committedTimeStampMs < 1000);
 
     if (_committedBlockID <= committedBlockID && !bootstrap)
         return;
@@ -344,9 +398,13 @@ void Schain::blockCommitArrived(bool bootstrap, block_id _committedBlockID, scha
 
     committedBlockID.store((uint64_t) _committedBlockID);
     committedBlockTimeStamp = _committedTimeStamp;
+    committedBlockTimeStampMs = _committedTimeStampMs;
+
+    getNode()->getNetwork()->releaseDeferredMessages(_committedBlockID + 1);
 
 
     uint64_t previousBlockTimeStamp = 0;
+    uint32_t previousBlockTimeStampMs = 0;
 
     ptr<BlockProposal> committedProposal = nullptr;
 
@@ -366,25 +424,27 @@ void Schain::blockCommitArrived(bool bootstrap, block_id _committedBlockID, scha
         processCommittedBlock(newCommittedBlock);
 
         previousBlockTimeStamp = newCommittedBlock->getTimeStamp();
+        previousBlockTimeStampMs = newCommittedBlock->getTimeStampMs();
 
     } else {
         LOG(info, "Jump starting the system with block" + to_string(_committedBlockID));
     }
 
 
-    proposeNextBlock(previousBlockTimeStamp);
+    proposeNextBlock(previousBlockTimeStamp, previousBlockTimeStampMs);
 
 }
 
 
-void Schain::proposeNextBlock(uint64_t _previousBlockTimeStamp) {
+void Schain::proposeNextBlock(uint64_t _previousBlockTimeStamp, uint32_t _previousBlockTimeStampMs) {
 
 
     block_id _proposedBlockID((uint64_t) committedBlockID + 1);
 
     ASSERT(pushedBlockProposals.count(_proposedBlockID) == 0);
 
-    auto myProposal = pendingTransactionsAgent->buildBlockProposal(_proposedBlockID, _previousBlockTimeStamp);
+    auto myProposal = pendingTransactionsAgent->buildBlockProposal(_proposedBlockID, _previousBlockTimeStamp,
+                                                                     _previousBlockTimeStampMs);
 
     ASSERT(myProposal->getProposerIndex() == getSchainIndex());
 
@@ -439,17 +499,14 @@ void Schain::processCommittedBlock(ptr<CommittedBlock> _block) {
 
     blockProposalsDatabase->cleanOldBlockProposals(_block->getBlockID());
 
-
-    if (extFace) {
-        pushBlockToExtFace(_block);
-    }
+    // the storage thread hands the block to skaled once it is durable
 
 
 }
 
 void Schain::saveBlock(ptr<CommittedBlock> &_block) {
     saveBlockToBlockCache(_block);
-    saveBlockToLevelDB(_block);
+    saveBlockToBlockLog(_block);
 }
 
 void Schain::saveBlockToBlockCache(ptr<CommittedBlock> &_block) {
@@ -463,37 +520,27 @@ void Schain::saveBlockToBlockCache(ptr<CommittedBlock> &_block) {
 
     auto storageSize = getNode()->getCommittedBlockStorageSize();
 
-    if (blockID > storageSize && blocks.count(blockID - storageSize) > 0) {
-        blocks.erase(committedBlockID - storageSize);
-    };
-
+    auto persistedBlockID = storageAgent->getPersistedBlockID();
 
-    ASSERT(blocks.size() <= storageSize);
+    // a block is only evicted once storage can serve it, so the cache may exceed its size
+    // by at most the storage queue
+    while (blocks.size() > storageSize && (uint64_t) blocks.begin()->first <= persistedBlockID) {
+        blocks.erase(blocks.begin());
+    }
 
 
 }
 
-void Schain::saveBlockToLevelDB(ptr<CommittedBlock> &_block) {
-    auto serializedBlock = _block->serialize();
-
-    using namespace leveldb;
-
-    auto db = getNode()->getBlocksDB();
-
-    auto key = to_string(getNode()->getNodeID()) + ":"
-               + to_string(_block->getBlockID());
-
-    auto value = (const char *) serializedBlock->data();
-
-    auto valueLen = serializedBlock->size();
-
-
-    db->writeByteArray(key, value, valueLen);
-
+void Schain::saveBlockToBlockLog(ptr<CommittedBlock> &_block) {
+    // serialization and disk writes happen on the storage thread
+    storageAgent->saveBlock(_block);
 }
 
 void Schain::pushBlockToExtFace(ptr<CommittedBlock> &_block) {
 
+    if (!extFace)
+        return;
+
     auto blockID = _block->getBlockID();
 
     ConsensusExtFace::transactions_vector tv;
@@ -507,7 +554,7 @@ void Schain::pushBlockToExtFace(ptr<CommittedBlock> &_block) {
 
     returnedBlock = (uint64_t) blockID;
 
-    extFace->createBlock(tv, _block->getTimeStamp(), (__uint64_t) _block->getBlockID());
+    extFace->createBlock(tv, _block->getTimeStamp(), _block->getTimeStampMs(), (__uint64_t) _block->getBlockID());
 }
 
 
@@ -576,6 +623,10 @@ const ptr<PendingTransactionsAgent> &Schain::getPendingTransactionsAgent() const
     return pendingTransactionsAgent;
 }
 
+const ptr<StorageAgent> &Schain::getStorageAgent() const {
+    return storageAgent;
+}
+
 chrono::milliseconds Schain::getStartTime() const {
     return startTime;
 }
@@ -589,7 +640,7 @@ ptr<CommittedBlock> Schain::getCachedBlock(block_id _blockID) {
 
     std::lock_guard<std::recursive_mutex> aLock(getMainMutex());
 
-    if (blocks.count(_blockID > 0)) {
+    if (blocks.count(_blockID) > 0) {
         return blocks[_blockID];
     } else {
         return nullptr;
@@ -605,14 +656,19 @@ ptr<CommittedBlock> Schain::getBlock(block_id _blockID) {
     if (block)
         return block;
 
-    return make_shared<CommittedBlock>(getSerializedBlockFromLevelDB(_blockID));
+    auto serializedBlock = getSerializedBlockFromStorage(_blockID);
+
+    if (!serializedBlock)
+        return nullptr;
+
+    return make_shared<CommittedBlock>(serializedBlock);
 
 }
 
 ptr<vector<uint8_t>> Schain::getSerializedBlockFromLevelDB(const block_id &_blockID) {
     using namespace leveldb;
 
-    string key = to_string((uint64_t) getNode()->getNodeID()) + ":" + to_string((uint64_t) _blockID);
+    string key = LevelDB::createBlockKey((uint64_t) getNode()->getNodeID(), (uint64_t) _blockID);
 
     auto value = getSchain()->getNode()->getBlocksDB()->readString(key);
 
@@ -625,6 +681,137 @@ ptr<vector<uint8_t>> Schain::getSerializedBlockFromLevelDB(const block_id &_bloc
     }
 }
 
+class SerializedBlockForwarder : public LevelDB::KeyValueVisitor {
+
+    uint64_t nextBlockID;
+
+    uint64_t maxBytes;
+
+    Schain::SerializedBlockVisitor *visitor;
+
+    uint64_t totalSize = 0;
+
+    uint64_t visitedBlocks = 0;
+
+public:
+
+    SerializedBlockForwarder(uint64_t _firstBlockID, uint64_t _maxBytes, Schain::SerializedBlockVisitor *_visitor) :
+            nextBlockID(_firstBlockID), maxBytes(_maxBytes), visitor(_visitor) {}
+
+    uint64_t getNextBlockID() const {
+        return nextBlockID;
+    }
+
+    uint64_t getVisitedBlocks() const {
+        return visitedBlocks;
+    }
+
+    bool forward(const uint8_t *_data, uint64_t _size) {
+
+        if (visitedBlocks > 0 && totalSize + _size > maxBytes)
+            return false;
+
+        visitor->visitSerializedBlock(_data, _size);
+
+        totalSize += _size;
+        visitedBlocks++;
+        nextBlockID++;
+
+        return true;
+    }
+
+    bool visitDBKeyValue(leveldb::Slice _key, leveldb::Slice _value) override {
+
+        uint64_t nodeID, blockID;
+
+        // stop at the first missing block
+        if (!LevelDB::parseBlockKey(_key, nodeID, blockID) || blockID != nextBlockID)
+            return false;
+
+        return forward((const uint8_t *) _value.data(), _value.size());
+    }
+};
+
+
+class SerializedBlockCopier : public Schain::SerializedBlockVisitor {
+
+public:
+
+    ptr<vector<ptr<vector<uint8_t>>>> blocks = make_shared<vector<ptr<vector<uint8_t>>>>();
+
+    void visitSerializedBlock(const uint8_t *_data, uint64_t _size) override {
+        blocks->push_back(make_shared<vector<uint8_t>>(_data, _data + _size));
+    }
+};
+
+
+ptr<vector<uint8_t>> Schain::getSerializedBlockFromStorage(const block_id &_blockID) {
+
+    auto serializedBlock = getNode()->getBlockLog()->readBlock((uint64_t) _blockID);
+
+    if (serializedBlock)
+        return serializedBlock;
+
+    return getSerializedBlockFromLevelDB(_blockID);
+}
+
+
+uint64_t Schain::visitSerializedBlocksFromStorage(block_id _firstBlockID, block_id _lastBlockID, uint64_t _maxBytes,
+                                                  SerializedBlockVisitor *_visitor) {
+
+    ASSERT(_visitor);
+
+    auto blockLog = getNode()->getBlockLog();
+
+    auto firstLogBlockID = blockLog->getFirstBlockID();
+
+    SerializedBlockForwarder forwarder((uint64_t) _firstBlockID, _maxBytes, _visitor);
+
+    auto lastBlockID = (uint64_t) _lastBlockID;
+
+    // blocks committed before the block log existed are still in LevelDB
+
+    if (forwarder.getNextBlockID() <= lastBlockID &&
+        (firstLogBlockID == 0 || forwarder.getNextBlockID() < firstLogBlockID)) {
+
+        auto lastLegacyBlockID = firstLogBlockID == 0 ? lastBlockID : min(lastBlockID, firstLogBlockID - 1);
+
+        auto nodeID = (uint64_t) getNode()->getNodeID();
+
+        getNode()->getBlocksDB()->visitKeyValues(LevelDB::createBlockKey(nodeID, forwarder.getNextBlockID()),
+                                                 LevelDB::createBlockKey(nodeID, lastLegacyBlockID + 1),
+                                                 &forwarder, lastLegacyBlockID - forwarder.getNextBlockID() + 1);
+
+        if (forwarder.getNextBlockID() <= lastLegacyBlockID)
+            return forwarder.getVisitedBlocks();
+    }
+
+    // the rest is passed straight from the mapped block log segments
+
+    while (forwarder.getNextBlockID() <= lastBlockID) {
+
+        const uint8_t *data;
+        uint64_t size;
+
+        if (!blockLog->read(forwarder.getNextBlockID(), data, size) || !forwarder.forward(data, size))
+            break;
+    }
+
+    return forwarder.getVisitedBlocks();
+}
+
+
+ptr<vector<ptr<vector<uint8_t>>>> Schain::getSerializedBlocksFromStorage(block_id _firstBlockID,
+                                                                        block_id _lastBlockID,
+                                                                        uint64_t _maxBytes) {
+
+    SerializedBlockCopier copier;
+
+    visitSerializedBlocksFromStorage(_firstBlockID, _lastBlockID, _maxBytes, &copier);
+
+    return copier.blocks;
+}
+
 
 schain_index Schain::getSchainIndex() const {
     return this->schainIndex;
@@ -645,9 +832,13 @@ node_count Schain::getNodeCount() {
 
 transaction_count Schain::getMessagesCount() {
 
-    std::lock_guard<std::recursive_mutex> aLock(getMainMutex());
+    uint64_t count = 0;
+
+    for (auto &&inbox : messageInboxes) {
+        count += inbox->getSize();
+    }
 
-    return transaction_count(messageQueue.size());
+    return transaction_count(count);
 }
 
 
@@ -695,7 +886,9 @@ void Schain::bootstrap(block_id _lastCommittedBlockID, uint64_t _lastCommittedBl
         ASSERT(bootStrapped == false);
         bootStrapped = true;
         bootstrapBlockID.store((uint64_t) _lastCommittedBlockID);
-        blockCommitArrived(true, _lastCommittedBlockID, schain_index(0), _lastCommittedBlockTimeStamp);
+        getNode()->getBlockLog()->reconcile((uint64_t) _lastCommittedBlockID);
+        blockCommitArrived(true, _lastCommittedBlockID, schain_index(0), _lastCommittedBlockTimeStamp,
+                           getStoredBlockTimeStampMs(_lastCommittedBlockID, _lastCommittedBlockTimeStamp));
     } catch (Exception &e) {
         Exception::log_exception(e);
         return;
@@ -703,6 +896,30 @@ void Schain::bootstrap(block_id _lastCommittedBlockID, uint64_t _lastCommittedBl
 }
 
 
+uint32_t Schain::getStoredBlockTimeStampMs(block_id _blockID, uint64_t _timeStamp) {
+
+    // skaled only knows seconds, empty block time stamps depend on the milliseconds as well
+    ptr<vector<uint8_t>> serializedBlock = nullptr;
+
+    if (_blockID > 0)
+        serializedBlock = getSerializedBlockFromStorage(_blockID);
+
+    if (!serializedBlock) {
+        LOG(warn, "No stored block " + to_string(_blockID) + " to restore the time stamp from");
+        return 0;
+    }
+
+    auto block = make_shared<CommittedBlock>(serializedBlock);
+
+    if (block->getTimeStamp() != _timeStamp) {
+        LOG(warn, "Stored block " + to_string(_blockID) + " time stamp differs from the committed one");
+        return 0;
+    }
+
+    return block->getTimeStampMs();
+}
+
+
 schain_id Schain::getSchainID() const {
     return schainID;
 }
@@ -716,6 +933,10 @@ uint64_t Schain::getCommittedBlockTimeStamp() {
     return committedBlockTimeStamp;
 }
 
+uint32_t Schain::getCommittedBlockTimeStampMs() {
+    return committedBlockTimeStampMs;
+}
+
 
 block_id Schain::getBootstrapBlockID() const {
     return bootstrapBlockID.load();
@@ -774,8 +995,13 @@ void Schain::healthCheck() {
 void Schain::sigShareArrived(ptr<BLSSigShare> _sigShare) {
     if (sigSharesDatabase->addSigShare(_sigShare)) {
         auto blockId = _sigShare->getBlockId();
+        auto block = getBlock(blockId);
+        if (!block) {
+            LOG(warn, "Sig share arrived for unknown block " + to_string(blockId));
+            return;
+        }
         auto mySig = this->getNode()->sign(
-                getBlock(blockId)->getHash(), blockId, getSchainIndex(),
+                block->getHash(), blockId, getSchainIndex(),
                                            getNode()->getNodeID());
         sigSharesDatabase->addSigShare(mySig);
         assert(sigSharesDatabase->isTwoThird(blockId));
@@ -24,6 +24,7 @@
 #pragma  once
 
 #include "../Agent.h"
+#include "../threads/MPSCQueue.h"
 
 
 class CommittedBlockList;
@@ -56,9 +57,11 @@ class MessageEnvelope;
 
 class Node;
 class PendingTransactionsAgent;
+class StorageAgent;
 
 class BlockConsensusAgent;
 class IO;
+class ClientConnectionPool;
 
 
 
@@ -106,6 +109,8 @@ private:
 
     ptr<PendingTransactionsAgent> pendingTransactionsAgent;
 
+    ptr<StorageAgent> storageAgent;
+
     ptr<BlockProposalClientAgent> blockProposalClient;
 
     ptr<BlockFinalizeClientAgent> blockFinalizeClient;
@@ -121,6 +126,8 @@ private:
 
     ptr<IO> io;
 
+    ptr<ClientConnectionPool> connectionPool;
+
 
 
     Node& node;
@@ -131,9 +138,10 @@ private:
     ptr<string> blockProposerTest ;
 
 
-    /*** Queue of unprocessed messages for this schain instance
+    /*** Inboxes of unprocessed messages, one per consensus thread. All messages of a binary consensus
+     * instance go to the same inbox, so instances of different proposers run in parallel
  */
-    queue<ptr<MessageEnvelope>> messageQueue;
+    vector<ptr<MPSCQueue<ptr<MessageEnvelope>>>> messageInboxes;
 
 
     /*** Queue of unprocessed messages for this schain instance
@@ -145,7 +153,7 @@ private:
 
     ptr<NodeInfo> thisNodeInfo = nullptr;
 
-    void proposeNextBlock(uint64_t _previousBlockTimeStamp);
+    void proposeNextBlock(uint64_t _previousBlockTimeStamp, uint32_t _previousBlockTimeStampMs);
 
 
     void processCommittedBlock(ptr<CommittedBlock> _block);
@@ -162,6 +170,8 @@ private:
 
     atomic<uint64_t>committedBlockTimeStamp;
 
+    atomic<uint32_t>committedBlockTimeStampMs;
+
     void constructChildAgents();
 
 
@@ -177,11 +187,15 @@ public:
 
     void startThreads();
 
-    static void messageThreadProcessingLoop(Schain *s);
+    static void messageThreadProcessingLoop(Schain *s, uint64_t _threadNumber);
+
+    void notifyAllConditionVariables() override;
 
 
     uint64_t getCommittedBlockTimeStamp();
 
+    uint32_t getCommittedBlockTimeStampMs();
+
 
     const ptr<ExternalQueueSyncAgent> &getExternalQueueSyncAgent() const;
 
@@ -197,15 +211,29 @@ public:
     void proposedBlockArrived(ptr<BlockProposal> pbm);
 
     void blockCommitArrived(bool bootstrap, block_id _committedBlockID, schain_index _proposerIndex,
-                                uint64_t _committedTimeStamp);
+                                uint64_t _committedTimeStamp, uint32_t _committedTimeStampMs);
 
 
     void blockCommitsArrivedThroughCatchup(ptr<CommittedBlockList> _blocks);
 
+    /**
+     * Commits blocks received through catchup without proposing, returns true if any block was new
+     */
+    bool applyBlocksArrivedThroughCatchup(ptr<CommittedBlockList> _blocks);
+
+    void proposeNextBlockAfterCatchup();
+
+    /**
+     * A peer has shown that it committed _peerBlockID, catch up right away if it is ahead of us
+     */
+    void lagDetected(schain_index _peerIndex, uint64_t _peerBlockID);
+
     void sigShareArrived(ptr<BLSSigShare> _sigShare);
 
     const ptr<IO> &getIo() const;
 
+    const ptr<ClientConnectionPool> &getConnectionPool() const;
+
 
 
 
@@ -216,6 +244,8 @@ public:
 
     const ptr<PendingTransactionsAgent> &getPendingTransactionsAgent() const;
 
+    const ptr<StorageAgent> &getStorageAgent() const;
+
 
     schain_index getSchainIndex() const;
 
@@ -260,6 +290,11 @@ public:
 
     void bootstrap(block_id _lastCommittedBlockID, uint64_t _lastCommittedBlockTimeStamp);
 
+    /**
+     * Millisecond part of the time stamp of a stored block, 0 if the block is not stored
+     */
+    uint32_t getStoredBlockTimeStampMs(block_id _blockID, uint64_t _timeStamp);
+
     schain_id getSchainID() const;
 
     uint64_t getTotalTransactions() const;
@@ -270,6 +305,8 @@ public:
 
     static uint64_t getCurrentTimeSec();
 
+    static uint64_t getCurrentTimeMs();
+
     block_id getBootstrapBlockID() const;
 
 
@@ -278,7 +315,7 @@ public:
     void
     pushBlockToExtFace(ptr<CommittedBlock> &_block);
 
-    void saveBlockToLevelDB(ptr<CommittedBlock> &_block);
+    void saveBlockToBlockLog(ptr<CommittedBlock> &_block);
 
     void saveBlockToBlockCache(ptr<CommittedBlock> &_block);
 
@@ -288,6 +325,30 @@ public:
 
     ptr<vector<uint8_t>> getSerializedBlockFromLevelDB(const block_id &_blockID);
 
+    /**
+     * Reads from the block log, blocks older than the log are read from LevelDB
+     */
+    ptr<vector<uint8_t>> getSerializedBlockFromStorage(const block_id &_blockID);
+
+    class SerializedBlockVisitor {
+      public:
+        /**
+         * _data is only valid during the call
+         */
+        virtual void visitSerializedBlock(const uint8_t *_data, uint64_t _size) = 0;
+    };
+
+    /**
+     * Visits consecutive stored blocks in order without copying them, blocks older than the block log
+     * are scanned from LevelDB. Stops at a missing block or once _maxBytes would be exceeded,
+     * the first block is always visited. Returns the number of visited blocks
+     */
+    uint64_t visitSerializedBlocksFromStorage(block_id _firstBlockID, block_id _lastBlockID, uint64_t _maxBytes,
+                                              SerializedBlockVisitor *_visitor);
+
+    ptr<vector<ptr<vector<uint8_t>>>> getSerializedBlocksFromStorage(block_id _firstBlockID, block_id _lastBlockID,
+                                                                     uint64_t _maxBytes);
+
 
 
 };
@@ -35,10 +35,12 @@
 #include "SchainMessageThreadPool.h"
 
 
-SchainMessageThreadPool::SchainMessageThreadPool(void *params_) : WorkerThreadPool(NUM_SCHAIN_THREADS, params_) {
+SchainMessageThreadPool::SchainMessageThreadPool(void *params_, num_threads _numThreads) :
+        WorkerThreadPool(_numThreads, params_) {
 
 }
 
-void SchainMessageThreadPool::createThread(uint64_t /*_threadNumber*/){
-    threadpool.push_back( make_shared < thread > ( Schain::messageThreadProcessingLoop, reinterpret_cast < Schain * > ( params ) ) );
+void SchainMessageThreadPool::createThread(uint64_t _threadNumber){
+    threadpool.push_back( make_shared < thread > ( Schain::messageThreadProcessingLoop, reinterpret_cast < Schain * > ( params ),
+            _threadNumber ) );
 }
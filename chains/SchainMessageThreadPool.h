@@ -34,8 +34,8 @@ class WorkerThreadPool;
 class SchainMessageThreadPool : public WorkerThreadPool {
 public:
 
-    SchainMessageThreadPool(void *params_);
+    SchainMessageThreadPool(void *params_, num_threads _numThreads);
 
-    virtual void createThread(uint64_t _numThreads);
+    virtual void createThread(uint64_t _threadNumber);
 };
 
@@ -0,0 +1,438 @@
+/*
+    Copyright (C) 2019 SKALE Labs
+
+    This file is part of skale-consensus.
+
+    skale-consensus is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    skale-consensus is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with skale-consensus.  If not, see <http://www.gnu.org/licenses/>.
+
+    @file SHA3BatchHasher.cpp
+    @author Stan Kladko
+    @date 2019
+*/
+
+
+#include "../SkaleConfig.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "SHA3BatchHasher.h"
+
+
+#if defined(__x86_64__)
+
+namespace {
+
+constexpr uint64_t SHA3_256_RATE = 136;
+
+constexpr uint64_t SHA3_LANES = 4;
+
+constexpr uint64_t SHA3_WIDE_LANES = 8;
+
+constexpr uint64_t KECCAK_ROUND_CONSTANTS[24] = {
+        0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL, 0x8000000080008000ULL,
+        0x000000000000808bULL, 0x0000000080000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
+        0x000000000000008aULL, 0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+        0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL, 0x8000000000008003ULL,
+        0x8000000000008002ULL, 0x8000000000000080ULL, 0x000000000000800aULL, 0x800000008000000aULL,
+        0x8000000080008081ULL, 0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL};
+
+// rotation offset of lane x + 5 * y
+constexpr int KECCAK_ROTATIONS[25] = {
+        0, 1, 62, 28, 27,
+        36, 44, 6, 55, 20,
+        3, 10, 43, 25, 39,
+        41, 45, 15, 21, 8,
+        18, 2, 61, 56, 14};
+
+
+__attribute__((target("avx2")))
+inline __m256i rotateLeft(__m256i _v, int _n) {
+    return _mm256_or_si256(_mm256_slli_epi64(_v, _n), _mm256_srli_epi64(_v, 64 - _n));
+}
+
+
+__attribute__((target("avx2")))
+void keccakF1600x4(__m256i *_a) {
+
+    __m256i b[25];
+    __m256i c[5];
+
+    for (uint64_t round = 0; round < 24; round++) {
+
+        for (int x = 0; x < 5; x++) {
+            c[x] = _mm256_xor_si256(_mm256_xor_si256(_a[x], _a[x + 5]),
+                                    _mm256_xor_si256(_mm256_xor_si256(_a[x + 10], _a[x + 15]), _a[x + 20]));
+        }
+
+        for (int x = 0; x < 5; x++) {
+            auto d = _mm256_xor_si256(c[(x + 4) % 5], rotateLeft(c[(x + 1) % 5], 1));
+            for (int y = 0; y < 25; y += 5) {
+                _a[x + y] = _mm256_xor_si256(_a[x + y], d);
+            }
+        }
+
+        // rho and pi
+        for (int x = 0; x < 5; x++) {
+            for (int y = 0; y < 5; y++) {
+                b[y + 5 * ((2 * x + 3 * y) % 5)] = rotateLeft(_a[x + 5 * y], KECCAK_ROTATIONS[x + 5 * y]);
+            }
+        }
+
+        // chi
+        for (int y = 0; y < 25; y += 5) {
+            for (int x = 0; x < 5; x++) {
+                _a[x + y] = _mm256_xor_si256(b[x + y], _mm256_andnot_si256(b[(x + 1) % 5 + y], b[(x + 2) % 5 + y]));
+            }
+        }
+
+        // iota
+        _a[0] = _mm256_xor_si256(_a[0], _mm256_set1_epi64x((long long) KECCAK_ROUND_CONSTANTS[round]));
+    }
+}
+
+
+__attribute__((target("avx2")))
+inline void absorbBlockx4(__m256i *_a, const uint8_t *const *_blocks) {
+    for (uint64_t i = 0; i < SHA3_256_RATE / 8; i++) {
+        uint64_t w[SHA3_LANES];
+        for (uint64_t j = 0; j < SHA3_LANES; j++) {
+            memcpy(&w[j], _blocks[j] + 8 * i, 8);
+        }
+        _a[i] = _mm256_xor_si256(_a[i], _mm256_loadu_si256((const __m256i *) w));
+    }
+    keccakF1600x4(_a);
+}
+
+
+/**
+ * SHA3-256 of four messages that span the same number of rate blocks
+ */
+__attribute__((target("avx2")))
+void sha3x4(const uint8_t *const *_messages, const uint64_t *_lengths, uint8_t *const *_digests) {
+
+    __m256i a[25];
+    for (auto &lane : a) {
+        lane = _mm256_setzero_si256();
+    }
+
+    auto fullBlocks = _lengths[0] / SHA3_256_RATE;
+
+    const uint8_t *blocks[SHA3_LANES];
+
+    for (uint64_t i = 0; i < fullBlocks; i++) {
+        for (uint64_t j = 0; j < SHA3_LANES; j++) {
+            blocks[j] = _messages[j] + i * SHA3_256_RATE;
+        }
+        absorbBlockx4(a, blocks);
+    }
+
+    uint8_t padded[SHA3_LANES][SHA3_256_RATE];
+
+    for (uint64_t j = 0; j < SHA3_LANES; j++) {
+        auto tail = _lengths[j] - fullBlocks * SHA3_256_RATE;
+        memset(padded[j], 0, SHA3_256_RATE);
+        if (tail > 0) {
+            memcpy(padded[j], _messages[j] + fullBlocks * SHA3_256_RATE, tail);
+        }
+        padded[j][tail] ^= 0x06;
+        padded[j][SHA3_256_RATE - 1] ^= 0x80;
+        blocks[j] = padded[j];
+    }
+
+    absorbBlockx4(a, blocks);
+
+    for (uint64_t i = 0; i < SHA3_HASH_LEN / 8; i++) {
+        uint64_t w[SHA3_LANES];
+        _mm256_storeu_si256((__m256i *) w, a[i]);
+        for (uint64_t j = 0; j < SHA3_LANES; j++) {
+            memcpy(_digests[j] + 8 * i, &w[j], 8);
+        }
+    }
+}
+
+
+// AVX-512 has native 64-bit rotates and three input logic ops. Theta's five way xor and chi take
+// half the instructions of the AVX2 version, on twice the lanes. Keccak is integer only, so it runs
+// under the light AVX-512 frequency license
+
+__attribute__((target("avx512f")))
+void keccakF1600x8(__m512i *_a) {
+
+    __m512i b[25];
+    __m512i c[5];
+
+    for (uint64_t round = 0; round < 24; round++) {
+
+        for (int x = 0; x < 5; x++) {
+            c[x] = _mm512_ternarylogic_epi64(_mm512_ternarylogic_epi64(_a[x], _a[x + 5], _a[x + 10], 0x96),
+                                             _a[x + 15], _a[x + 20], 0x96);
+        }
+
+        for (int x = 0; x < 5; x++) {
+            auto d = _mm512_xor_si512(c[(x + 4) % 5], _mm512_rol_epi64(c[(x + 1) % 5], 1));
+            for (int y = 0; y < 25; y += 5) {
+                _a[x + y] = _mm512_xor_si512(_a[x + y], d);
+            }
+        }
+
+        // rho and pi
+        for (int x = 0; x < 5; x++) {
+            for (int y = 0; y < 5; y++) {
+                b[y + 5 * ((2 * x + 3 * y) % 5)] = _mm512_rolv_epi64(_a[x + 5 * y],
+                                                                     _mm512_set1_epi64(KECCAK_ROTATIONS[x + 5 * y]));
+            }
+        }
+
+        // chi, 0xd2 is a ^ (~b & c)
+        for (int y = 0; y < 25; y += 5) {
+            for (int x = 0; x < 5; x++) {
+                _a[x + y] = _mm512_ternarylogic_epi64(b[x + y], b[(x + 1) % 5 + y], b[(x + 2) % 5 + y], 0xd2);
+            }
+        }
+
+        // iota
+        _a[0] = _mm512_xor_si512(_a[0], _mm512_set1_epi64((long long) KECCAK_ROUND_CONSTANTS[round]));
+    }
+}
+
+
+__attribute__((target("avx512f")))
+inline void absorbBlockx8(__m512i *_a, const uint8_t *const *_blocks) {
+    for (uint64_t i = 0; i < SHA3_256_RATE / 8; i++) {
+        uint64_t w[SHA3_WIDE_LANES];
+        for (uint64_t j = 0; j < SHA3_WIDE_LANES; j++) {
+            memcpy(&w[j], _blocks[j] + 8 * i, 8);
+        }
+        _a[i] = _mm512_xor_si512(_a[i], _mm512_loadu_si512(w));
+    }
+    keccakF1600x8(_a);
+}
+
+
+/**
+ * SHA3-256 of eight messages that span the same number of rate blocks
+ */
+__attribute__((target("avx512f")))
+void sha3x8(const uint8_t *const *_messages, const uint64_t *_lengths, uint8_t *const *_digests) {
+
+    __m512i a[25];
+    for (auto &lane : a) {
+        lane = _mm512_setzero_si512();
+    }
+
+    auto fullBlocks = _lengths[0] / SHA3_256_RATE;
+
+    const uint8_t *blocks[SHA3_WIDE_LANES];
+
+    for (uint64_t i = 0; i < fullBlocks; i++) {
+        for (uint64_t j = 0; j < SHA3_WIDE_LANES; j++) {
+            blocks[j] = _messages[j] + i * SHA3_256_RATE;
+        }
+        absorbBlockx8(a, blocks);
+    }
+
+    uint8_t padded[SHA3_WIDE_LANES][SHA3_256_RATE];
+
+    for (uint64_t j = 0; j < SHA3_WIDE_LANES; j++) {
+        auto tail = _lengths[j] - fullBlocks * SHA3_256_RATE;
+        memset(padded[j], 0, SHA3_256_RATE);
+        if (tail > 0) {
+            memcpy(padded[j], _messages[j] + fullBlocks * SHA3_256_RATE, tail);
+        }
+        padded[j][tail] ^= 0x06;
+        padded[j][SHA3_256_RATE - 1] ^= 0x80;
+        blocks[j] = padded[j];
+    }
+
+    absorbBlockx8(a, blocks);
+
+    for (uint64_t i = 0; i < SHA3_HASH_LEN / 8; i++) {
+        uint64_t w[SHA3_WIDE_LANES];
+        _mm512_storeu_si512(w, a[i]);
+        for (uint64_t j = 0; j < SHA3_WIDE_LANES; j++) {
+            memcpy(_digests[j] + 8 * i, &w[j], 8);
+        }
+    }
+}
+
+
+typedef void (*sha3_kernel)(const uint8_t *const *, const uint64_t *, uint8_t *const *);
+
+}
+
+#endif
+
+
+SHA3BatchHasher::SHA3BatchHasher() {
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx2")) {
+        avx2 = selfCheck(SHA3_LANES);
+    }
+    if (__builtin_cpu_supports("avx512f")) {
+        avx512 = selfCheck(SHA3_WIDE_LANES);
+    }
+#endif
+}
+
+
+SHA3BatchHasher &SHA3BatchHasher::getInstance() {
+    static SHA3BatchHasher instance;
+    return instance;
+}
+
+
+bool SHA3BatchHasher::isVectorized() {
+    return getInstance().avx2 || getInstance().avx512;
+}
+
+
+uint64_t SHA3BatchHasher::getLanes() {
+    auto &instance = getInstance();
+    return instance.avx512 ? SHA3_WIDE_LANES : (instance.avx2 ? SHA3_LANES : 1);
+}
+
+
+void SHA3BatchHasher::hashOne(const uint8_t *_message, uint64_t _length, uint8_t *_digest) {
+    CryptoPP::SHA3 hashObject(SHA3_HASH_LEN);
+    hashObject.Update(_message, _length);
+    hashObject.Final(_digest);
+}
+
+
+bool SHA3BatchHasher::selfCheck(uint64_t _lanes) {
+
+#if defined(__x86_64__)
+
+    sha3_kernel kernel = _lanes == SHA3_WIDE_LANES ? sha3x8 : sha3x4;
+
+    // lengths around the block boundaries, where padding bugs would show
+    const uint64_t lengths[] = {0, 1, 55, 135, 136, 137, 271, 272, 1000};
+
+    vector<uint8_t> message(1000);
+    for (uint64_t i = 0; i < message.size(); i++) {
+        message[i] = (uint8_t) (i * 131 + 7);
+    }
+
+    for (auto length : lengths) {
+
+        uint8_t expected[SHA3_HASH_LEN];
+        hashOne(message.data(), length, expected);
+
+        uint8_t actual[SHA3_WIDE_LANES][SHA3_HASH_LEN];
+        const uint8_t *messages[SHA3_WIDE_LANES];
+        uint64_t messageLengths[SHA3_WIDE_LANES];
+        uint8_t *digests[SHA3_WIDE_LANES];
+
+        for (uint64_t j = 0; j < _lanes; j++) {
+            messages[j] = message.data();
+            messageLengths[j] = length;
+            digests[j] = actual[j];
+        }
+
+        kernel(messages, messageLengths, digests);
+
+        for (uint64_t j = 0; j < _lanes; j++) {
+            if (memcmp(expected, actual[j], SHA3_HASH_LEN) != 0) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+
+#else
+    return false;
+#endif
+}
+
+
+void SHA3BatchHasher::hash(const uint8_t *const *_messages, const uint64_t *_lengths, uint64_t _count,
+                           uint8_t *_digests) {
+
+    uint64_t done = 0;
+
+#if defined(__x86_64__)
+
+    auto &instance = getInstance();
+
+    if (_count >= SHA3_LANES && (instance.avx2 || instance.avx512)) {
+
+        // group messages that take the same number of blocks, so that all lanes finish together
+        vector<pair<uint64_t, uint64_t>> order(_count);
+        for (uint64_t i = 0; i < _count; i++) {
+            order[i] = {_lengths[i] / SHA3_256_RATE, i};
+        }
+        sort(order.begin(), order.end());
+
+        vector<bool> hashed(_count, false);
+
+        uint64_t i = 0;
+
+        while (i + SHA3_LANES <= _count) {
+
+            // eight lanes where a full group has the same block count, four lanes for the rest
+            uint64_t lanes;
+
+            if (instance.avx512 && i + SHA3_WIDE_LANES <= _count &&
+                order[i].first == order[i + SHA3_WIDE_LANES - 1].first) {
+                lanes = SHA3_WIDE_LANES;
+            } else if (instance.avx2 && order[i].first == order[i + SHA3_LANES - 1].first) {
+                lanes = SHA3_LANES;
+            } else {
+                i++;
+                continue;
+            }
+
+            const uint8_t *messages[SHA3_WIDE_LANES];
+            uint64_t lengths[SHA3_WIDE_LANES];
+            uint8_t *digests[SHA3_WIDE_LANES];
+
+            for (uint64_t j = 0; j < lanes; j++) {
+                auto index = order[i + j].second;
+                messages[j] = _messages[index];
+                lengths[j] = _lengths[index];
+                digests[j] = _digests + index * SHA3_HASH_LEN;
+                hashed[index] = true;
+            }
+
+            if (lanes == SHA3_WIDE_LANES) {
+                sha3x8(messages, lengths, digests);
+            } else {
+                sha3x4(messages, lengths, digests);
+            }
+
+            i += lanes;
+            done += lanes;
+        }
+
+        if (done == _count)
+            return;
+
+        for (uint64_t k = 0; k < _count; k++) {
+            if (!hashed[k]) {
+                hashOne(_messages[k], _lengths[k], _digests + k * SHA3_HASH_LEN);
+            }
+        }
+
+        return;
+    }
+
+#endif
+
+    for (; done < _count; done++) {
+        hashOne(_messages[done], _lengths[done], _digests + done * SHA3_HASH_LEN);
+    }
+}
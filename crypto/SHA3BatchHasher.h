@@ -0,0 +1,64 @@
+/*
+    Copyright (C) 2019 SKALE Labs
+
+    This file is part of skale-consensus.
+
+    skale-consensus is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    skale-consensus is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with skale-consensus.  If not, see <http://www.gnu.org/licenses/>.
+
+    @file SHA3BatchHasher.h
+    @author Stan Kladko
+    @date 2019
+*/
+
+#pragma once
+
+
+/**
+ * Computes SHA3-256 of many independent messages at once. Messages with the same number of
+ * Keccak blocks are absorbed in parallel, one message per 64-bit vector lane: eight at a time
+ * on CPUs with AVX-512F, four at a time with AVX2. Everything else, and every CPU without
+ * either, goes through CryptoPP. bench/SHA3BatchHasherBench.cpp compares the paths.
+ *
+ * Each vector kernel is checked against CryptoPP on first use and is disabled if any digest
+ * differs, so the output is always byte-identical to CryptoPP::SHA3.
+ */
+class SHA3BatchHasher {
+
+    bool avx2 = false;
+
+    bool avx512 = false;
+
+    SHA3BatchHasher();
+
+    static SHA3BatchHasher &getInstance();
+
+    static void hashOne(const uint8_t *_message, uint64_t _length, uint8_t *_digest);
+
+    bool selfCheck(uint64_t _lanes);
+
+public:
+
+    /**
+     * Writes the SHA3_HASH_LEN byte digest of message i to _digests + i * SHA3_HASH_LEN
+     */
+    static void hash(const uint8_t *const *_messages, const uint64_t *_lengths, uint64_t _count,
+                     uint8_t *_digests);
+
+    static bool isVectorized();
+
+    /**
+     * Messages hashed in parallel by the widest enabled kernel, 1 without one
+     */
+    static uint64_t getLanes();
+};
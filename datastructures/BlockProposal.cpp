@@ -58,6 +58,11 @@ void BlockProposal::calculateHash() {
     sha3.Update(reinterpret_cast < uint8_t * > ( &transactionCount ), sizeof(transactionCount));
     sha3.Update(reinterpret_cast < uint8_t * > ( &timeStamp ), sizeof(timeStamp));
 
+    // blocks with second resolution time stamps hash exactly as before
+    if (timeStampMs != 0) {
+        sha3.Update(reinterpret_cast < uint8_t * > ( &timeStampMs ), sizeof(timeStampMs));
+    }
+
 
     for (uint64_t i = 0; i < transactionCount; i++) {
         auto t = transactionList->getItems();
@@ -76,14 +81,17 @@ BlockProposal::BlockProposal(uint64_t _timeStamp) : timeStamp(_timeStamp) {
 };
 
 BlockProposal::BlockProposal(Schain &_sChain, block_id _blockID, schain_index _proposerIndex,
-                             ptr<TransactionList> _transactions, uint64_t _timeStamp) : schainID(_sChain.getSchainID()),
-                                                                                        blockID(_blockID),
-                                                                                        proposerIndex(_proposerIndex),
-                                                                                        timeStamp(_timeStamp),
-                                                                                        transactionList(_transactions) {
+                             ptr<TransactionList> _transactions, uint64_t _timeStamp,
+                             uint32_t _timeStampMs) : schainID(_sChain.getSchainID()),
+                                                      blockID(_blockID),
+                                                      proposerIndex(_proposerIndex),
+                                                      timeStamp(_timeStamp),
+                                                      timeStampMs(_timeStampMs),
+                                                      transactionList(_transactions) {
     proposerNodeID = _sChain.getNodeID(_proposerIndex);
 
     ASSERT(timeStamp > MODERN_TIME);
+    ASSERT(timeStampMs < 1000);
     transactionCount = transactionList->getItems()->size();
     calculateHash();
 
@@ -152,4 +160,8 @@ uint64_t BlockProposal::getTimeStamp() const {
     return timeStamp;
 }
 
+uint32_t BlockProposal::getTimeStampMs() const {
+    return timeStampMs;
+}
+
 
@@ -47,6 +47,7 @@ protected:
 
     transaction_count transactionCount;
     uint64_t  timeStamp = 0;
+    uint32_t  timeStampMs = 0;
 
 protected:
     ptr<TransactionList> transactionList;
@@ -60,13 +61,15 @@ protected:
     BlockProposal(uint64_t _timeStamp);
 
     BlockProposal(Schain &_sChain, block_id _blockID, schain_index _proposerIndex,
-                  ptr<TransactionList> _transactions, uint64_t _timeStamp);
+                  ptr<TransactionList> _transactions, uint64_t _timeStamp, uint32_t _timeStampMs);
 
 
 public:
 
     uint64_t getTimeStamp() const;
 
+    uint32_t getTimeStampMs() const;
+
 
 
     const transaction_count &getTransactionsCount() const;
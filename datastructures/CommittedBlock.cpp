@@ -44,12 +44,14 @@ CommittedBlock::CommittedBlock(Schain &_sChain, ptr<BlockProposal> _p) : BlockPr
                                                                                        _p->getBlockID(),
                                                                                        _p->getProposerIndex(),
                                                                                        _p->getTransactionList(),
-                                                                                       _p->getTimeStamp()) {
+                                                                                       _p->getTimeStamp(),
+                                                                                       _p->getTimeStampMs()) {
 }
 
 
 ptr<vector<uint8_t>> CommittedBlock::serialize() {
 
+    lock_guard<mutex> lock(serializeMutex);
 
     if (serializedBlock != nullptr) {
         return serializedBlock;
@@ -141,6 +143,8 @@ CommittedBlock::CommittedBlock(ptr<vector<uint8_t>> _serializedBlock) : BlockPro
         this->schainID = schain_id(Header::getUint64(js, "schainID"));
         this->timeStamp = Header::getUint64(js, "timeStamp");
 
+        this->timeStampMs = Header::getTimeStampMs(js);
+
         this->transactionCount = js["sizes"].size();
         this->hash = SHAHash::fromHex(Header::getString(js, "hash"));
 
@@ -42,6 +42,9 @@ public:
 
     ptr<vector<uint8_t>> serialize();
 
+    // the storage thread and catchup servers serialize concurrently
+    mutex serializeMutex;
+
     ptr<vector<uint8_t>> serializedBlock = nullptr;
 
 };
\ No newline at end of file
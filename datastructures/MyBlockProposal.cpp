@@ -26,8 +26,9 @@
 #include "MyBlockProposal.h"
 
 MyBlockProposal::MyBlockProposal(Schain &_sChain, const block_id &_blockID, const schain_index &_proposerIndex,
-                                 const ptr<TransactionList>_transactions, uint64_t _timeStamp)
-        : BlockProposal(_sChain, _blockID, _proposerIndex, _transactions, _timeStamp) {
+                                 const ptr<TransactionList>_transactions, uint64_t _timeStamp,
+                                 uint32_t _timeStampMs)
+        : BlockProposal(_sChain, _blockID, _proposerIndex, _transactions, _timeStamp, _timeStampMs) {
     totalObjects++;
 };
 
@@ -67,3 +67,17 @@ ptr<partial_sha_hash> PartialHashesList::getPartialHash(uint64_t i) {
 
     return hash;
 }
+
+
+uint64_t PartialHashesList::getPartialHashKey(uint64_t i) {
+    if (i >= transactionCount) {
+        BOOST_THROW_EXCEPTION(
+                NetworkProtocolException("Index i is more than messageCount:" + to_string(i), __CLASS_NAME__));
+    }
+
+    static_assert(PARTIAL_SHA_HASH_LEN == sizeof(uint64_t), "Partial hash must fit into uint64");
+
+    uint64_t key;
+    memcpy(&key, partialHashes->data() + PARTIAL_SHA_HASH_LEN * i, sizeof(key));
+    return key;
+}
@@ -53,6 +53,8 @@ public:
 
     ptr<partial_sha_hash> getPartialHash(uint64_t i) ;
 
+    uint64_t getPartialHashKey(uint64_t i);
+
 };
 
 
@@ -28,9 +28,10 @@
 ReceivedBlockProposal::ReceivedBlockProposal(Schain &_sChain, const block_id &_blockID,
                                              const schain_index &_proposerIndex,
                                              const ptr<TransactionList> &_transactions,
-                                             const uint64_t &_timeStamp) : BlockProposal(_sChain, _blockID,
-                                                                                         _proposerIndex, _transactions,
-                                                                                         _timeStamp) {
+                                             const uint64_t &_timeStamp,
+                                             const uint32_t &_timeStampMs) : BlockProposal(_sChain, _blockID,
+                                                                                           _proposerIndex, _transactions,
+                                                                                           _timeStamp, _timeStampMs) {
     totalObjects++;
 }
 
@@ -31,7 +31,8 @@
 class ReceivedBlockProposal : public BlockProposal{
 public:
     ReceivedBlockProposal(Schain &_sChain, const block_id &_blockID, const schain_index &_proposerIndex,
-                          const ptr<TransactionList> & _transactions, const uint64_t &_timeStamp);
+                          const ptr<TransactionList> & _transactions, const uint64_t &_timeStamp,
+                          const uint32_t &_timeStampMs);
 
 
     static uint64_t getTotalObjects() {
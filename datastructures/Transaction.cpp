@@ -31,6 +31,7 @@
 #include "../Log.h"
 #include "../exceptions/FatalError.h"
 #include "../crypto/SHAHash.h"
+#include "../crypto/SHA3BatchHasher.h"
 
 #include "Transaction.h"
 
@@ -77,6 +78,43 @@ ptr<partial_sha_hash> Transaction::getPartialHash() {
 
 }
 
+uint64_t Transaction::getPartialHashKey() {
+    uint64_t key;
+    memcpy(&key, getPartialHash()->data(), sizeof(key));
+    return key;
+}
+
+void Transaction::computeHashes(const vector<ptr<Transaction>> &_transactions, uint64_t _begin, uint64_t _end) {
+
+    vector<Transaction *> pending;
+    vector<const uint8_t *> messages;
+    vector<uint64_t> lengths;
+
+    for (auto i = _begin; i < _end; i++) {
+        auto transaction = _transactions[i].get();
+        if (transaction->hash)
+            continue;
+        ASSERT(transaction->data && transaction->data->size() > 0);
+        pending.push_back(transaction);
+        messages.push_back(transaction->data->data());
+        lengths.push_back(transaction->data->size());
+    }
+
+    if (pending.empty())
+        return;
+
+    vector<uint8_t> digests(pending.size() * SHA3_HASH_LEN);
+
+    SHA3BatchHasher::hash(messages.data(), lengths.data(), pending.size(), digests.data());
+
+    for (uint64_t i = 0; i < pending.size(); i++) {
+        auto digest = make_shared<array<uint8_t, SHA3_HASH_LEN>>();
+        memcpy(digest->data(), digests.data() + i * SHA3_HASH_LEN, SHA3_HASH_LEN);
+        pending[i]->hash = make_shared<SHAHash>(digest);
+        pending[i]->getPartialHash();
+    }
+}
+
 Transaction::Transaction(const ptr<vector<uint8_t>> data) : data(data) {
 
 };
@@ -55,6 +55,17 @@ public:
 
     ptr<partial_sha_hash> getPartialHash();
 
+    /**
+     * Partial hash as an inline map key, no allocation
+     */
+    uint64_t getPartialHashKey();
+
+    /**
+     * Computes the hashes of transactions [_begin, _end) in one multi-buffer pass,
+     * transactions that already have a hash are skipped
+     */
+    static void computeHashes(const vector<ptr<Transaction>> &_transactions, uint64_t _begin, uint64_t _end);
+
     virtual ~Transaction();
 
 
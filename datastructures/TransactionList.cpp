@@ -27,6 +27,7 @@
 #include "../exceptions/FatalError.h"
 #include "Transaction.h"
 #include "ImportedTransaction.h"
+#include "../threads/TransactionHashingPool.h"
 
 #include "TransactionList.h"
 
@@ -60,6 +61,8 @@ TransactionList::TransactionList(ptr<vector<size_t>> transactionSizes_,
         index = endIndex;
     }
 
+    // received transactions are looked up by partial hash right away
+    TransactionHashingPool::hashTransactions(*transactions);
 
 };
 
@@ -0,0 +1,624 @@
+/*
+    Copyright (C) 2019 SKALE Labs
+
+    This file is part of skale-consensus.
+
+    skale-consensus is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    skale-consensus is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with skale-consensus.  If not, see <http://www.gnu.org/licenses/>.
+
+    @file BlockLog.cpp
+    @author Stan Kladko
+    @date 2019
+*/
+
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "../SkaleConfig.h"
+#include "../Log.h"
+#include "../exceptions/FatalError.h"
+#include "../exceptions/BlockLogException.h"
+
+#include "BlockLog.h"
+
+
+static constexpr uint64_t BLOCK_LOG_MAGIC = 0x534B424C4F474958;
+
+static constexpr uint64_t BLOCK_LOG_VERSION = 1;
+
+
+BlockLog::BlockLog(const string &_directory) : directory(_directory) {
+
+    if (mkdir(directory.c_str(), 0755) != 0) {
+        if (errno != EEXIST) {
+            BOOST_THROW_EXCEPTION(BlockLogException("Could not create " + directory + ":" + strerror(errno),
+                                                    __CLASS_NAME__));
+        }
+    } else {
+        syncDirectory(getParentDirectory());
+    }
+
+    openIndex();
+    openSegments();
+    recover();
+    openRanges();
+}
+
+
+BlockLog::~BlockLog() {
+
+    for (auto &&segment : retiredSegments) {
+        munmap(segment->data, segment->mappedSize);
+        close(segment->fd);
+    }
+
+    for (auto &&segment : segments) {
+        if (segment->data != nullptr)
+            munmap(segment->data, segment->mappedSize);
+        if (segment->fd >= 0)
+            close(segment->fd);
+    }
+
+    if (indexData != nullptr)
+        munmap(indexData, sizeof(IndexHeader) + indexCapacity * sizeof(IndexEntry));
+
+    if (indexFD >= 0)
+        close(indexFD);
+}
+
+
+BlockLog::IndexHeader *BlockLog::getIndexHeader() {
+    return (IndexHeader *) indexData;
+}
+
+
+BlockLog::IndexEntry *BlockLog::getIndexEntry(uint64_t _i) {
+    ASSERT(_i < indexCapacity);
+    return (IndexEntry *) (indexData + sizeof(IndexHeader)) + _i;
+}
+
+
+string BlockLog::getParentDirectory() {
+    auto separator = directory.rfind('/');
+    return separator == string::npos ? string(".") : directory.substr(0, separator);
+}
+
+
+void BlockLog::syncDirectory(const string &_path) {
+
+    // file creation and renames are only durable once the directory entry is synced
+
+    int fd = open(_path.c_str(), O_RDONLY | O_DIRECTORY);
+
+    if (fd < 0 || fsync(fd) != 0) {
+        auto error = string(strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        BOOST_THROW_EXCEPTION(BlockLogException("Could not sync directory " + _path + ":" + error, __CLASS_NAME__));
+    }
+
+    close(fd);
+}
+
+
+string BlockLog::getSegmentFileName(uint64_t _number) {
+    char name[32];
+    snprintf(name, sizeof(name), "/segment_%010lu", (unsigned long) _number);
+    return directory + name;
+}
+
+
+void BlockLog::mapIndex(uint64_t _capacity) {
+
+    auto fileSize = sizeof(IndexHeader) + _capacity * sizeof(IndexEntry);
+
+    if (ftruncate(indexFD, fileSize) != 0) {
+        BOOST_THROW_EXCEPTION(BlockLogException(string("Could not resize index:") + strerror(errno),
+                                                __CLASS_NAME__));
+    }
+
+    if (indexData != nullptr) {
+        munmap(indexData, sizeof(IndexHeader) + indexCapacity * sizeof(IndexEntry));
+    }
+
+    indexData = (uint8_t *) mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, indexFD, 0);
+
+    if (indexData == MAP_FAILED) {
+        indexData = nullptr;
+        BOOST_THROW_EXCEPTION(BlockLogException(string("Could not map index:") + strerror(errno),
+                                                __CLASS_NAME__));
+    }
+
+    indexCapacity = _capacity;
+}
+
+
+void BlockLog::openIndex() {
+
+    auto fileName = directory + "/index";
+
+    indexFD = open(fileName.c_str(), O_RDWR | O_CREAT, 0644);
+
+    if (indexFD < 0) {
+        BOOST_THROW_EXCEPTION(BlockLogException("Could not open " + fileName + ":" + strerror(errno),
+                                                __CLASS_NAME__));
+    }
+
+    struct stat st;
+
+    ASSERT(fstat(indexFD, &st) == 0);
+
+    if ((uint64_t) st.st_size < sizeof(IndexHeader)) {
+        mapIndex(BLOCK_LOG_INITIAL_INDEX_ENTRIES);
+        auto header = getIndexHeader();
+        header->magic = BLOCK_LOG_MAGIC;
+        header->version = BLOCK_LOG_VERSION;
+        header->firstBlockID = 0;
+        header->syncedCount = 0;
+        syncDirectory(directory);
+    } else {
+        mapIndex(max(((uint64_t) st.st_size - sizeof(IndexHeader)) / sizeof(IndexEntry),
+                     BLOCK_LOG_INITIAL_INDEX_ENTRIES));
+    }
+
+    auto header = getIndexHeader();
+
+    if (header->magic != BLOCK_LOG_MAGIC || header->version != BLOCK_LOG_VERSION) {
+        BOOST_THROW_EXCEPTION(BlockLogException("Invalid index file " + fileName, __CLASS_NAME__));
+    }
+
+    count = min(header->syncedCount, indexCapacity);
+}
+
+
+ptr<BlockLog::Segment> BlockLog::openSegment(uint64_t _number, uint64_t _minMappedSize) {
+
+    auto fileName = getSegmentFileName(_number);
+
+    auto segment = make_shared<Segment>();
+
+    segment->fd = open(fileName.c_str(), O_RDWR | O_CREAT, 0644);
+
+    if (segment->fd < 0) {
+        BOOST_THROW_EXCEPTION(BlockLogException("Could not open " + fileName + ":" + strerror(errno),
+                                                __CLASS_NAME__));
+    }
+
+    struct stat st;
+
+    ASSERT(fstat(segment->fd, &st) == 0);
+
+    segment->size = st.st_size;
+
+    // the mapping is reserved up front, so it never moves while the segment grows
+    segment->mappedSize = max(max(BLOCK_LOG_SEGMENT_SIZE, _minMappedSize), segment->size);
+
+    segment->data = (uint8_t *) mmap(nullptr, segment->mappedSize, PROT_READ, MAP_SHARED, segment->fd, 0);
+
+    if (segment->data == MAP_FAILED) {
+        segment->data = nullptr;
+        BOOST_THROW_EXCEPTION(BlockLogException("Could not map " + fileName + ":" + strerror(errno),
+                                                __CLASS_NAME__));
+    }
+
+    return segment;
+}
+
+
+void BlockLog::openSegments() {
+
+    auto dir = opendir(directory.c_str());
+
+    ASSERT(dir);
+
+    uint64_t segmentCount = 0;
+
+    while (auto entry = readdir(dir)) {
+        string name(entry->d_name);
+        if (name.find("segment_") == 0) {
+            segmentCount = max(segmentCount, (uint64_t) stoull(name.substr(8)) + 1);
+        }
+    }
+
+    closedir(dir);
+
+    for (uint64_t i = 0; i < segmentCount; i++) {
+        segments.push_back(openSegment(i, 0));
+    }
+}
+
+
+void BlockLog::openRanges() {
+
+    auto separator = directory.rfind('/');
+    auto parent = getParentDirectory();
+    auto prefix = (separator == string::npos ? directory : directory.substr(separator + 1)) + ".range_";
+
+    auto dir = opendir(parent.c_str());
+
+    ASSERT(dir);
+
+    map<uint64_t, string> rangeDirectories;
+
+    while (auto entry = readdir(dir)) {
+        string name(entry->d_name);
+        if (name.find(prefix) == 0 && name.find('.', prefix.size()) == string::npos) {
+            rangeDirectories[stoull(name.substr(prefix.size()))] = parent + "/" + name;
+        }
+    }
+
+    closedir(dir);
+
+    for (auto &&range : rangeDirectories) {
+        ranges.push_back(make_shared<BlockLog>(range.second));
+    }
+}
+
+
+void BlockLog::startRangeUnlocked() {
+
+    if (count == 0)
+        return;
+
+    syncUnlocked();
+
+    auto rangeDirectory = directory + ".range_" + to_string(getIndexHeader()->firstBlockID);
+
+    // a single rename, so a crash leaves either the old range or the closed one
+    if (rename(directory.c_str(), rangeDirectory.c_str()) != 0) {
+        BOOST_THROW_EXCEPTION(BlockLogException("Could not rename " + directory + ":" + strerror(errno),
+                                                __CLASS_NAME__));
+    }
+
+    // the mappings follow the renamed files, so pointers handed to readers stay valid
+    retiredSegments.insert(retiredSegments.end(), segments.begin(), segments.end());
+    segments.clear();
+    unsyncedSegments.clear();
+
+    munmap(indexData, sizeof(IndexHeader) + indexCapacity * sizeof(IndexEntry));
+    close(indexFD);
+    indexData = nullptr;
+    indexFD = -1;
+    indexCapacity = 0;
+    count = 0;
+
+    if (mkdir(directory.c_str(), 0755) != 0) {
+        BOOST_THROW_EXCEPTION(BlockLogException("Could not create " + directory + ":" + strerror(errno),
+                                                __CLASS_NAME__));
+    }
+
+    // makes both the rename and the new directory durable
+    syncDirectory(getParentDirectory());
+
+    openIndex();
+
+    ranges.push_back(make_shared<BlockLog>(rangeDirectory));
+
+    LOG(info, "Block log range closed:" + rangeDirectory);
+}
+
+
+void BlockLog::addIndexEntry(uint64_t _blockID, uint64_t _segment, uint64_t _offset, uint64_t _length) {
+
+    if (count == 0) {
+        getIndexHeader()->firstBlockID = _blockID;
+    }
+
+    if (count == indexCapacity) {
+        mapIndex(indexCapacity * 2);
+    }
+
+    auto entry = getIndexEntry(count);
+    entry->segment = _segment;
+    entry->offset = _offset;
+    entry->length = _length;
+
+    count++;
+}
+
+
+void BlockLog::recover() {
+
+    // a segment lost or cut short by a crash invalidates the index entries pointing into it
+
+    uint64_t valid = 0;
+
+    while (valid < count) {
+        auto entry = getIndexEntry(valid);
+        if (entry->segment >= segments.size() || entry->offset < sizeof(RecordHeader) ||
+            entry->offset + entry->length > segments[entry->segment]->size)
+            break;
+        valid++;
+    }
+
+    if (valid < count) {
+        LOG(warn, "Block log index truncated from " + to_string(count) + " to " + to_string(valid) + " blocks");
+        count = valid;
+        getIndexHeader()->syncedCount = count;
+    }
+
+    if (segments.empty())
+        return;
+
+    uint64_t segmentNumber = 0;
+    uint64_t position = 0;
+
+    if (count > 0) {
+        auto last = getIndexEntry(count - 1);
+        segmentNumber = last->segment;
+        position = last->offset + last->length;
+    }
+
+    uint64_t recovered = 0;
+
+    // everything after the last synced entry is validated record by record
+
+    while (segmentNumber < segments.size()) {
+
+        auto segment = segments[segmentNumber];
+
+        if (position == segment->size && segmentNumber + 1 < segments.size()) {
+            segmentNumber++;
+            position = 0;
+            continue;
+        }
+
+        bool valid = position + sizeof(RecordHeader) <= segment->size;
+
+        RecordHeader header;
+
+        if (valid) {
+            memcpy(&header, segment->data + position, sizeof(header));
+            auto expectedBlockID = getIndexHeader()->firstBlockID + count;
+            valid = (count == 0 || header.blockID == expectedBlockID) &&
+                    header.length <= segment->size - position - sizeof(RecordHeader) &&
+                    checksum(segment->data + position + sizeof(RecordHeader), header.length) == header.checksum;
+        }
+
+        if (!valid) {
+            // a torn write from a crash, drop it together with everything after it
+            if (ftruncate(segment->fd, position) != 0) {
+                BOOST_THROW_EXCEPTION(BlockLogException(string("Could not truncate segment:") + strerror(errno),
+                                                        __CLASS_NAME__));
+            }
+            segment->size = position;
+
+            while (segments.size() > segmentNumber + 1) {
+                auto removed = segments.back();
+                munmap(removed->data, removed->mappedSize);
+                close(removed->fd);
+                unlink(getSegmentFileName(segments.size() - 1).c_str());
+                segments.pop_back();
+            }
+            break;
+        }
+
+        addIndexEntry(header.blockID, segmentNumber, position + sizeof(RecordHeader), header.length);
+        position += sizeof(RecordHeader) + header.length;
+        recovered++;
+    }
+
+    unsyncedSegments.insert(segments.size() - 1);
+
+    syncUnlocked();
+
+    LOG(info, "Block log opened, blocks:" + to_string(count) + " recovered:" + to_string(recovered));
+}
+
+
+void BlockLog::append(uint64_t _blockID, const uint8_t *_data, uint64_t _len) {
+
+    ASSERT(_data);
+
+    lock_guard<mutex> lock(logMutex);
+
+    if (count > 0 && _blockID != getIndexHeader()->firstBlockID + count) {
+        LOG(warn, "Non consecutive block " + to_string(_blockID) + ", starting a new block log range");
+        startRangeUnlocked();
+    }
+
+    auto recordSize = sizeof(RecordHeader) + _len;
+
+    if (segments.empty() || segments.back()->size + recordSize > segments.back()->mappedSize) {
+        segments.push_back(openSegment(segments.size(), recordSize));
+        syncDirectory(directory);
+    }
+
+    auto segmentNumber = segments.size() - 1;
+    auto segment = segments.back();
+
+    RecordHeader header;
+    header.blockID = _blockID;
+    header.length = _len;
+    header.checksum = checksum(_data, _len);
+
+    struct iovec iov[2];
+    iov[0].iov_base = &header;
+    iov[0].iov_len = sizeof(header);
+    iov[1].iov_base = (void *) _data;
+    iov[1].iov_len = _len;
+
+    uint64_t written = 0;
+
+    while (written < recordSize) {
+
+        ssize_t result;
+
+        if (written < sizeof(header)) {
+            result = pwritev(segment->fd, iov, 2, segment->size + written);
+        } else {
+            result = pwrite(segment->fd, _data + written - sizeof(header), recordSize - written,
+                            segment->size + written);
+        }
+
+        if (result < 0) {
+            if (errno == EINTR)
+                continue;
+            BOOST_THROW_EXCEPTION(BlockLogException(string("Could not write block:") + strerror(errno),
+                                                    __CLASS_NAME__));
+        }
+
+        written += result;
+
+        if (written < sizeof(header)) {
+            iov[0].iov_base = (uint8_t *) &header + written;
+            iov[0].iov_len = sizeof(header) - written;
+        }
+    }
+
+    addIndexEntry(_blockID, segmentNumber, segment->size + sizeof(RecordHeader), _len);
+
+    segment->size += recordSize;
+
+    unsyncedSegments.insert(segmentNumber);
+}
+
+
+void BlockLog::syncUnlocked() {
+
+    // data has to be durable before the index says it is
+
+    for (auto &&number : unsyncedSegments) {
+        if (fdatasync(segments[number]->fd) != 0) {
+            BOOST_THROW_EXCEPTION(BlockLogException(string("Could not sync segment:") + strerror(errno),
+                                                    __CLASS_NAME__));
+        }
+    }
+
+    unsyncedSegments.clear();
+
+    getIndexHeader()->syncedCount = count;
+
+    if (msync(indexData, sizeof(IndexHeader) + count * sizeof(IndexEntry), MS_SYNC) != 0) {
+        BOOST_THROW_EXCEPTION(BlockLogException(string("Could not sync index:") + strerror(errno),
+                                                __CLASS_NAME__));
+    }
+}
+
+
+void BlockLog::reconcile(uint64_t _lastCommittedBlockID) {
+
+    lock_guard<mutex> lock(logMutex);
+
+    if (count == 0)
+        return;
+
+    auto nextBlockID = getIndexHeader()->firstBlockID + count;
+
+    if (_lastCommittedBlockID + 1 > nextBlockID) {
+        // the blocks in between were committed but never made it to the log
+        LOG(warn, "Block log ends at " + to_string(nextBlockID - 1) + ", behind committed block " +
+                  to_string(_lastCommittedBlockID));
+        startRangeUnlocked();
+    } else if (_lastCommittedBlockID + 1 < nextBlockID) {
+        LOG(info, "Block log ends at " + to_string(nextBlockID - 1) + ", ahead of committed block " +
+                  to_string(_lastCommittedBlockID));
+    }
+}
+
+
+void BlockLog::sync() {
+    lock_guard<mutex> lock(logMutex);
+    syncUnlocked();
+}
+
+
+bool BlockLog::read(uint64_t _blockID, const uint8_t *&_data, uint64_t &_len) {
+
+    lock_guard<mutex> lock(logMutex);
+
+    auto firstBlockID = getIndexHeader()->firstBlockID;
+
+    if (count == 0 || _blockID < firstBlockID || _blockID >= firstBlockID + count) {
+        for (auto &&range : ranges) {
+            if (range->read(_blockID, _data, _len))
+                return true;
+        }
+        return false;
+    }
+
+    auto entry = getIndexEntry(_blockID - firstBlockID);
+
+    _data = segments[entry->segment]->data + entry->offset;
+    _len = entry->length;
+
+    return true;
+}
+
+
+ptr<vector<uint8_t>> BlockLog::readBlock(uint64_t _blockID) {
+
+    const uint8_t *data;
+    uint64_t len;
+
+    if (!read(_blockID, data, len))
+        return nullptr;
+
+    return make_shared<vector<uint8_t>>(data, data + len);
+}
+
+
+bool BlockLog::contains(uint64_t _blockID) {
+    const uint8_t *data;
+    uint64_t len;
+    return read(_blockID, data, len);
+}
+
+
+uint64_t BlockLog::getFirstBlockID() {
+
+    lock_guard<mutex> lock(logMutex);
+
+    uint64_t result = count > 0 ? getIndexHeader()->firstBlockID : 0;
+
+    for (auto &&range : ranges) {
+        auto firstBlockID = range->getFirstBlockID();
+        if (firstBlockID != 0 && (result == 0 || firstBlockID < result))
+            result = firstBlockID;
+    }
+
+    return result;
+}
+
+
+uint64_t BlockLog::getLastBlockID() {
+
+    lock_guard<mutex> lock(logMutex);
+
+    uint64_t result = count > 0 ? getIndexHeader()->firstBlockID + count - 1 : 0;
+
+    for (auto &&range : ranges) {
+        result = max(result, range->getLastBlockID());
+    }
+
+    return result;
+}
+
+
+uint64_t BlockLog::checksum(const uint8_t *_data, uint64_t _len) {
+
+    // FNV-1a
+
+    uint64_t hash = 0xcbf29ce484222325;
+
+    for (uint64_t i = 0; i < _len; i++) {
+        hash ^= _data[i];
+        hash *= 0x100000001b3;
+    }
+
+    return hash;
+}
@@ -0,0 +1,164 @@
+/*
+    Copyright (C) 2019 SKALE Labs
+
+    This file is part of skale-consensus.
+
+    skale-consensus is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    skale-consensus is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with skale-consensus.  If not, see <http://www.gnu.org/licenses/>.
+
+    @file BlockLog.h
+    @author Stan Kladko
+    @date 2019
+*/
+
+
+#pragma once
+
+
+/**
+ * Append-only store for committed blocks.
+ *
+ * Blocks are appended to segment files as records of (blockID, length, checksum, data).
+ * A memory-mapped index file maps consecutive block ids to (segment, offset, length).
+ * Segments are mapped read-only, so readers get pointers straight into the page cache.
+ * sync() makes everything appended so far durable. After a crash, the records that
+ * follow the last synced index entry are recovered by scanning the segment tail.
+ * A block that does not follow the last one closes the current range: its directory is renamed
+ * to <directory>.range_<firstBlockID> and stays readable, and a new range starts with the block.
+ */
+class BlockLog {
+
+    class Segment {
+    public:
+        int fd = -1;
+
+        uint8_t *data = nullptr;
+
+        uint64_t mappedSize = 0;
+
+        uint64_t size = 0;
+    };
+
+    struct IndexHeader {
+        uint64_t magic;
+        uint64_t version;
+        uint64_t firstBlockID;
+        uint64_t syncedCount;
+    };
+
+    struct IndexEntry {
+        uint64_t segment;
+        uint64_t offset;
+        uint64_t length;
+    };
+
+    struct RecordHeader {
+        uint64_t blockID;
+        uint64_t length;
+        uint64_t checksum;
+    };
+
+    string directory;
+
+    mutex logMutex;
+
+    vector<ptr<Segment>> segments;
+
+    // closed ranges, read only
+    vector<ptr<BlockLog>> ranges;
+
+    // mappings of segments moved to a closed range, readers may still point into them
+    vector<ptr<Segment>> retiredSegments;
+
+    set<uint64_t> unsyncedSegments;
+
+    int indexFD = -1;
+
+    uint8_t *indexData = nullptr;
+
+    uint64_t indexCapacity = 0;
+
+    uint64_t count = 0;
+
+    IndexHeader *getIndexHeader();
+
+    IndexEntry *getIndexEntry(uint64_t _i);
+
+    string getSegmentFileName(uint64_t _number);
+
+    void openIndex();
+
+    void mapIndex(uint64_t _capacity);
+
+    void openSegments();
+
+    void openRanges();
+
+    string getParentDirectory();
+
+    static void syncDirectory(const string &_path);
+
+    void startRangeUnlocked();
+
+    ptr<Segment> openSegment(uint64_t _number, uint64_t _minMappedSize);
+
+    void addIndexEntry(uint64_t _blockID, uint64_t _segment, uint64_t _offset, uint64_t _length);
+
+    void recover();
+
+    void syncUnlocked();
+
+    static uint64_t checksum(const uint8_t *_data, uint64_t _len);
+
+public:
+
+    explicit BlockLog(const string &_directory);
+
+    virtual ~BlockLog();
+
+    /**
+     * Appends the block, a non consecutive block id starts a new range
+     */
+    void append(uint64_t _blockID, const uint8_t *_data, uint64_t _len);
+
+    /**
+     * Matches the log against the last block committed to skaled on startup.
+     * If skaled is ahead of the log, the current range is closed and the next block starts a new one.
+     * If the log is ahead, the blocks it already has are verified and skipped by the caller as they are committed again.
+     */
+    void reconcile(uint64_t _lastCommittedBlockID);
+
+    bool contains(uint64_t _blockID);
+
+    /**
+     * Makes all appended blocks durable
+     */
+    void sync();
+
+    /**
+     * Points _data to the stored block, the memory stays valid as long as the log exists
+     */
+    bool read(uint64_t _blockID, const uint8_t *&_data, uint64_t &_len);
+
+    ptr<vector<uint8_t>> readBlock(uint64_t _blockID);
+
+    /**
+     * First block in the log over all ranges, 0 if the log is empty
+     */
+    uint64_t getFirstBlockID();
+
+    /**
+     * Last block in the log over all ranges, 0 if the log is empty
+     */
+    uint64_t getLastBlockID();
+};
@@ -26,6 +26,7 @@
 #include "../Log.h"
 #include "../thirdparty/json.hpp"
 #include "leveldb/db.h"
+#include "leveldb/write_batch.h"
 
 #include "../chains/Schain.h"
 #include "../datastructures/TransactionList.h"
@@ -117,6 +118,196 @@ uint64_t LevelDB::visitKeys(LevelDB::KeyVisitor *_visitor, uint64_t _maxKeysToVi
     return readCounter;
 }
 
+uint64_t LevelDB::visitKeyValues(const string &_startKey, const string &_endKey, KeyValueVisitor *_visitor,
+                                 uint64_t _maxKeysToVisit) {
+
+    uint64_t readCounter = 0;
+
+    // sequential scans should not evict the hot part of the block cache
+    ReadOptions scanOptions;
+    scanOptions.fill_cache = false;
+
+    leveldb::Iterator *it = db->NewIterator(scanOptions);
+
+    Slice endKey(_endKey);
+
+    for (it->Seek(Slice(_startKey)); it->Valid() && readCounter < _maxKeysToVisit; it->Next()) {
+
+        if (it->key().compare(endKey) >= 0)
+            break;
+
+        readCounter++;
+
+        if (!_visitor->visitDBKeyValue(it->key(), it->value()))
+            break;
+    }
+
+    auto status = it->status();
+
+    delete it;
+
+    throwExceptionOnError(status);
+
+    return readCounter;
+}
+
+
+uint64_t LevelDB::visitKeyValuesReverse(const string &_startKey, const string &_endKey, KeyValueVisitor *_visitor,
+                                        uint64_t _maxKeysToVisit) {
+
+    uint64_t readCounter = 0;
+
+    ReadOptions scanOptions;
+    scanOptions.fill_cache = false;
+
+    leveldb::Iterator *it = db->NewIterator(scanOptions);
+
+    Slice startKey(_startKey);
+
+    // position on the last key before _endKey
+    it->Seek(Slice(_endKey));
+
+    if (it->Valid()) {
+        it->Prev();
+    } else {
+        it->SeekToLast();
+    }
+
+    for (; it->Valid() && readCounter < _maxKeysToVisit; it->Prev()) {
+
+        if (it->key().compare(startKey) < 0)
+            break;
+
+        readCounter++;
+
+        if (!_visitor->visitDBKeyValue(it->key(), it->value()))
+            break;
+    }
+
+    auto status = it->status();
+
+    delete it;
+
+    throwExceptionOnError(status);
+
+    return readCounter;
+}
+
+
+void LevelDB::writeBatch(const vector<pair<string, string>> &_writes, const vector<string> &_deletes) {
+
+    WriteBatch batch;
+
+    for (auto &&item : _writes) {
+        batch.Put(Slice(item.first), Slice(item.second));
+    }
+
+    for (auto &&key : _deletes) {
+        batch.Delete(Slice(key));
+    }
+
+    throwExceptionOnError(db->Write(writeOptions, &batch));
+}
+
+
+void LevelDB::appendUint64BigEndian(string &_s, uint64_t _value) {
+    for (int i = 7; i >= 0; i--) {
+        _s.push_back((char) ((_value >> (i * 8)) & 0xFF));
+    }
+}
+
+
+uint64_t LevelDB::parseUint64BigEndian(const char *_data) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value = (value << 8) | (uint8_t) _data[i];
+    }
+    return value;
+}
+
+
+string LevelDB::createBlockKey(uint64_t _nodeID, uint64_t _blockID) {
+
+    string key;
+    key.reserve(BLOCK_KEY_LEN);
+
+    key.push_back(BLOCK_KEY_PREFIX);
+    appendUint64BigEndian(key, _nodeID);
+    appendUint64BigEndian(key, _blockID);
+
+    return key;
+}
+
+
+bool LevelDB::parseBlockKey(Slice _key, uint64_t &_nodeID, uint64_t &_blockID) {
+
+    if (_key.size() != BLOCK_KEY_LEN || _key.data()[0] != BLOCK_KEY_PREFIX)
+        return false;
+
+    _nodeID = parseUint64BigEndian(_key.data() + 1);
+    _blockID = parseUint64BigEndian(_key.data() + 1 + sizeof(uint64_t));
+
+    return true;
+}
+
+
+void LevelDB::migrateBlockKeys() {
+
+    static string versionKey("VERSION:BLOCK_KEYS");
+
+    auto version = readString(versionKey);
+
+    if (version != nullptr && *version == to_string(BLOCK_KEYS_VERSION))
+        return;
+
+    vector<pair<string, string>> writes;
+    vector<string> deletes;
+
+    uint64_t migrated = 0;
+
+    leveldb::Iterator *it = db->NewIterator(readOptions);
+
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+
+        auto oldKey = it->key().ToString();
+
+        auto separator = oldKey.find(':');
+
+        if (separator == string::npos || separator == 0 || separator + 1 == oldKey.size() ||
+            oldKey.find_first_not_of("0123456789:") != string::npos) {
+            continue;
+        }
+
+        auto nodeID = stoull(oldKey.substr(0, separator));
+        auto blockID = stoull(oldKey.substr(separator + 1));
+
+        writes.emplace_back(createBlockKey(nodeID, blockID), it->value().ToString());
+        deletes.push_back(oldKey);
+
+        if (writes.size() >= BLOCK_KEY_MIGRATION_BATCH) {
+            writeBatch(writes, deletes);
+            migrated += writes.size();
+            writes.clear();
+            deletes.clear();
+        }
+    }
+
+    auto status = it->status();
+
+    delete it;
+
+    throwExceptionOnError(status);
+
+    writes.emplace_back(versionKey, to_string(BLOCK_KEYS_VERSION));
+
+    writeBatch(writes, deletes);
+
+    migrated += deletes.size();
+
+    LOG(info, "Migrated block keys:" + to_string(migrated));
+}
+
+
 LevelDB::LevelDB(string &filename) {
 
 
@@ -60,6 +60,48 @@ public:
 
     uint64_t visitKeys(KeyVisitor* _visitor, uint64_t _maxKeysToVisit);
 
+    class KeyValueVisitor {
+      public:
+        /**
+         * Returns false to stop the scan
+         */
+        virtual bool visitDBKeyValue(leveldb::Slice _key, leveldb::Slice _value) = 0;
+    };
+
+    /**
+     * Visits keys in [_startKey, _endKey) in key order using a single iterator
+     */
+    uint64_t visitKeyValues(const string &_startKey, const string &_endKey, KeyValueVisitor *_visitor,
+                            uint64_t _maxKeysToVisit);
+
+    /**
+     * Same as visitKeyValues, newest (largest) keys first
+     */
+    uint64_t visitKeyValuesReverse(const string &_startKey, const string &_endKey, KeyValueVisitor *_visitor,
+                                   uint64_t _maxKeysToVisit);
+
+    /**
+     * Applies all writes and deletes atomically
+     */
+    void writeBatch(const vector<pair<string, string>> &_writes, const vector<string> &_deletes);
+
+    /**
+     * Block keys are the prefix byte followed by big endian node id and block id,
+     * so that blocks of a node are stored in block order
+     */
+    static string createBlockKey(uint64_t _nodeID, uint64_t _blockID);
+
+    static void appendUint64BigEndian(string &_s, uint64_t _value);
+
+    static uint64_t parseUint64BigEndian(const char *_data);
+
+    static bool parseBlockKey(leveldb::Slice _key, uint64_t &_nodeID, uint64_t &_blockID);
+
+    /**
+     * Rewrites blocks stored under the old "<nodeID>:<blockID>" string keys, done once per database
+     */
+    void migrateBlockKeys();
+
     virtual ~LevelDB();
 
 };
@@ -0,0 +1,274 @@
+/*
+    Copyright (C) 2019 SKALE Labs
+
+    This file is part of skale-consensus.
+
+    skale-consensus is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    skale-consensus is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with skale-consensus.  If not, see <http://www.gnu.org/licenses/>.
+
+    @file StorageAgent.cpp
+    @author Stan Kladko
+    @date 2019
+*/
+
+
+#include <fcntl.h>
+
+#include "../SkaleConfig.h"
+#include "../Log.h"
+#include "../exceptions/FatalError.h"
+#include "../exceptions/ExitRequestedException.h"
+#include "../exceptions/BlockLogException.h"
+
+#include "../thirdparty/json.hpp"
+#include "../chains/Schain.h"
+#include "../node/Node.h"
+#include "../threads/WorkerThreadPool.h"
+#include "../crypto/SHAHash.h"
+#include "../datastructures/CommittedBlock.h"
+#include "../pendingqueue/PendingTransactionsAgent.h"
+#include "BlockLog.h"
+#include "LevelDB.h"
+
+#include "StorageAgent.h"
+
+
+StorageAgent::StorageAgent(Schain &_sChain) : Agent(_sChain, false), persistedBlockID(0) {
+    pending = make_shared<WriteGroup>();
+}
+
+
+void StorageAgent::startThread() {
+    storageThread = make_shared<thread>(std::bind(&StorageAgent::storageLoop, this));
+    WorkerThreadPool::addThread(storageThread);
+}
+
+
+void StorageAgent::saveBlock(ptr<CommittedBlock> _block) {
+
+    ASSERT(_block);
+
+    unique_lock<mutex> lock(storageMutex);
+
+    // back pressure only kicks in if the disk falls far behind
+    while (pending->blocks.size() >= MAX_STORAGE_QUEUE_BLOCKS && !getNode()->isExitRequested()) {
+        persistedCond.wait_for(lock, chrono::milliseconds(100));
+    }
+
+    queuedBlockID = max(queuedBlockID, (uint64_t) _block->getBlockID());
+    pending->blocks.push_back(_block);
+
+    storageCond.notify_one();
+}
+
+
+void StorageAgent::saveCommittedTransactions(string _key, string _value) {
+    lock_guard<mutex> lock(storageMutex);
+    pending->transactionWrites.emplace_back(std::move(_key), std::move(_value));
+    storageCond.notify_one();
+}
+
+
+void StorageAgent::saveSignature(string _key, string _value) {
+    lock_guard<mutex> lock(storageMutex);
+    pending->signatureWrites.emplace_back(std::move(_key), std::move(_value));
+    storageCond.notify_one();
+}
+
+
+void StorageAgent::saveCommittedFilterSnapshot(block_id _blockID, ptr<string> _snapshot) {
+    lock_guard<mutex> lock(storageMutex);
+    filterSnapshot = _snapshot;
+    filterSnapshotBlockID = (uint64_t) _blockID;
+    storageCond.notify_one();
+}
+
+
+bool StorageAgent::waitUntilPersisted(block_id _blockID, uint64_t _timeoutMs) {
+
+    unique_lock<mutex> lock(storageMutex);
+
+    return persistedCond.wait_for(lock, chrono::milliseconds(_timeoutMs), [this, _blockID]() {
+        return persistedBlockID >= (uint64_t) _blockID;
+    });
+}
+
+
+uint64_t StorageAgent::getPersistedBlockID() const {
+    return persistedBlockID;
+}
+
+
+void StorageAgent::writeFilterSnapshotIfPersisted() {
+
+    ptr<string> snapshot;
+
+    {
+        lock_guard<mutex> lock(storageMutex);
+        if (!filterSnapshot || filterSnapshotBlockID > persistedBlockID)
+            return;
+        snapshot = filterSnapshot;
+        filterSnapshot = nullptr;
+    }
+
+    writeFilterSnapshot(snapshot);
+}
+
+
+void StorageAgent::writeFilterSnapshot(const ptr<string> &_snapshot) {
+
+    auto path = getNode()->getCommittedFilterSnapshotPath();
+    auto tmpPath = path + ".tmp";
+
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (fd < 0) {
+        LOG(err, "Could not create committed transactions snapshot " + tmpPath);
+        return;
+    }
+
+    uint64_t written = 0;
+
+    while (written < _snapshot->size()) {
+        auto result = ::write(fd, _snapshot->data() + written, _snapshot->size() - written);
+        if (result <= 0) {
+            LOG(err, "Could not write committed transactions snapshot " + tmpPath);
+            close(fd);
+            unlink(tmpPath.c_str());
+            return;
+        }
+        written += result;
+    }
+
+    // the snapshot is only an optimization, a torn one fails the checksum and the history is replayed
+    fdatasync(fd);
+    close(fd);
+
+    if (rename(tmpPath.c_str(), path.c_str()) != 0) {
+        LOG(err, "Could not rename committed transactions snapshot " + tmpPath);
+        unlink(tmpPath.c_str());
+    }
+}
+
+
+void StorageAgent::write(const ptr<WriteGroup> &_group) {
+
+    if (!_group->blocks.empty()) {
+
+        auto blockLog = getNode()->getBlockLog();
+
+        for (auto &&block : _group->blocks) {
+
+            auto storedBlock = blockLog->readBlock((uint64_t) block->getBlockID());
+
+            // the log can be ahead of skaled after a restart, a committed block never changes
+            if (storedBlock) {
+                if (make_shared<CommittedBlock>(storedBlock)->getHash()->compare(block->getHash()) != 0) {
+                    BOOST_THROW_EXCEPTION(BlockLogException("Stored block differs from committed block " +
+                                                            to_string(block->getBlockID()), __CLASS_NAME__));
+                }
+                continue;
+            }
+
+            auto serializedBlock = block->serialize();
+            blockLog->append((uint64_t) block->getBlockID(), serializedBlock->data(), serializedBlock->size());
+        }
+
+        // one sync per group
+        blockLog->sync();
+    }
+
+    if (!_group->transactionWrites.empty()) {
+        getNode()->getCommittedTransactionsDB()->writeBatch(_group->transactionWrites, {});
+    }
+
+    if (!_group->signatureWrites.empty()) {
+        getNode()->getSignaturesDB()->writeBatch(_group->signatureWrites, {});
+    }
+}
+
+
+void StorageAgent::deliver(const ptr<WriteGroup> &_group) {
+
+    // blocks left undelivered on exit are persisted and get committed again after the restart
+    for (auto &&block : _group->blocks) {
+        if (getNode()->isExitRequested())
+            return;
+        getSchain()->pushBlockToExtFace(block);
+    }
+
+    // committed blocks drain the pending queue, the host hears about it once no consensus lock is held
+    getSchain()->getPendingTransactionsAgent()->notifyPendingQueueWatermark();
+}
+
+
+void StorageAgent::storageLoop() {
+
+    setThreadName(__CLASS_NAME__);
+
+    waitOnGlobalStartBarrier();
+
+    try {
+        while (true) {
+
+            ptr<WriteGroup> group;
+            uint64_t groupBlockID;
+
+            {
+                unique_lock<mutex> lock(storageMutex);
+
+                storageCond.wait_for(lock, chrono::milliseconds(1000), [this]() {
+                    return !pending->blocks.empty() || !pending->transactionWrites.empty() ||
+                           !pending->signatureWrites.empty() || getNode()->isExitRequested();
+                });
+
+                if (pending->blocks.empty() && pending->transactionWrites.empty() &&
+                    pending->signatureWrites.empty()) {
+                    // queued writes are always flushed before the thread exits
+                    if (getNode()->isExitRequested())
+                        break;
+                    continue;
+                }
+
+                group = pending;
+                groupBlockID = queuedBlockID;
+                pending = make_shared<WriteGroup>();
+            }
+
+            write(group);
+
+            {
+                lock_guard<mutex> lock(storageMutex);
+                persistedBlockID = max((uint64_t) persistedBlockID, groupBlockID);
+            }
+
+            persistedCond.notify_all();
+
+            deliver(group);
+
+            writeFilterSnapshotIfPersisted();
+        }
+
+        // take a final snapshot on graceful exit so that the next start does not replay the history
+        uint64_t blockID;
+        auto snapshot = getSchain()->getPendingTransactionsAgent()->createCommittedFilterSnapshot(blockID);
+        saveCommittedFilterSnapshot(blockID, snapshot);
+        writeFilterSnapshotIfPersisted();
+
+    } catch (ExitRequestedException &) {
+        return;
+    } catch (Exception &e) {
+        Exception::log_exception(e);
+        getNode()->exitOnFatalError("Could not write to storage");
+    }
+}
@@ -0,0 +1,107 @@
+/*
+    Copyright (C) 2019 SKALE Labs
+
+    This file is part of skale-consensus.
+
+    skale-consensus is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    skale-consensus is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with skale-consensus.  If not, see <http://www.gnu.org/licenses/>.
+
+    @file StorageAgent.h
+    @author Stan Kladko
+    @date 2019
+*/
+
+
+#pragma once
+
+#include "../Agent.h"
+
+
+class CommittedBlock;
+
+
+/**
+ * Write-behind storage pipeline. Committed blocks, per-block committed transaction records and
+ * block signatures are queued by the consensus thread and written by a dedicated thread.
+ * Everything queued between two group commits goes to the block log with a single sync and to
+ * each LevelDB database with a single WriteBatch.
+ * Committed transaction filter snapshots are written only after the block they cover is persisted.
+ * Blocks are handed to skaled by the same thread once their group is persisted, so skaled never
+ * executes a block that a crash could lose.
+ */
+class StorageAgent : public Agent {
+
+    class WriteGroup {
+    public:
+        vector<ptr<CommittedBlock>> blocks;
+
+        vector<pair<string, string>> transactionWrites;
+
+        vector<pair<string, string>> signatureWrites;
+    };
+
+    mutex storageMutex;
+
+    condition_variable storageCond;
+
+    condition_variable persistedCond;
+
+    ptr<WriteGroup> pending;
+
+    uint64_t queuedBlockID = 0;
+
+    atomic<uint64_t> persistedBlockID;
+
+    ptr<thread> storageThread = nullptr;
+
+    ptr<string> filterSnapshot = nullptr;
+
+    uint64_t filterSnapshotBlockID = 0;
+
+    void storageLoop();
+
+    void write(const ptr<WriteGroup> &_group);
+
+    void deliver(const ptr<WriteGroup> &_group);
+
+    void writeFilterSnapshotIfPersisted();
+
+    void writeFilterSnapshot(const ptr<string> &_snapshot);
+
+public:
+
+    explicit StorageAgent(Schain &_sChain);
+
+    void startThread();
+
+    /**
+     * Queues the block, never waits for the disk unless the queue is full
+     */
+    void saveBlock(ptr<CommittedBlock> _block);
+
+    void saveCommittedTransactions(string _key, string _value);
+
+    void saveSignature(string _key, string _value);
+
+    /**
+     * Replaces any snapshot that has not been written yet
+     */
+    void saveCommittedFilterSnapshot(block_id _blockID, ptr<string> _snapshot);
+
+    /**
+     * Durability fence, waits until the block and everything queued before it is persisted
+     */
+    bool waitUntilPersisted(block_id _blockID, uint64_t _timeoutMs);
+
+    uint64_t getPersistedBlockID() const;
+};
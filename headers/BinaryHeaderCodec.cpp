@@ -0,0 +1,363 @@
+/*
+    Copyright (C) 2018-2019 SKALE Labs
+
+    This file is part of skale-consensus.
+
+    skale-consensus is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    skale-consensus is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with skale-consensus.  If not, see <http://www.gnu.org/licenses/>.
+
+    @file BinaryHeaderCodec.cpp
+    @author Stan Kladko
+    @date 2018
+*/
+
+
+#include "../SkaleConfig.h"
+#include "../Log.h"
+#include "../exceptions/FatalError.h"
+#include "../exceptions/ParsingException.h"
+
+#include "../thirdparty/json.hpp"
+
+#include "BinaryHeaderCodec.h"
+
+
+namespace {
+
+enum binary_header_type : uint8_t {
+    BH_UINT = 0, BH_NEGATIVE_INT = 1, BH_STRING = 2, BH_HEX_STRING = 3, BH_DECIMAL_STRING = 4,
+    BH_UINT_ARRAY = 5, BH_FALSE = 6, BH_TRUE = 7, BH_NULL = 8, BH_JSON = 9
+};
+
+// append only, the position of a name is its id on the wire
+const vector<string> FIELD_NAMES = {
+        "status", "substatus", "type", "schainID", "blockID", "proposerIndex", "proposerNodeID", "hash",
+        "timeStamp", "timeStampMs", "partialHashesCount", "count", "sizes", "sigShare", "srcNodeID",
+        "dstNodeID", "srcSchainIndex", "dstSchainIndex", "maxBlocks", "maxBytes", "committedBlockID"
+};
+
+const char DECIMAL_SYMBOLS[] = "0123456789:";
+
+bool isHex(const string &_s) {
+    if (_s.empty() || _s.size() % 2 != 0)
+        return false;
+    for (auto c : _s) {
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f')))
+            return false;
+    }
+    return true;
+}
+
+bool isDecimal(const string &_s) {
+    if (_s.empty())
+        return false;
+    for (auto c : _s) {
+        if (!((c >= '0' && c <= '9') || c == ':'))
+            return false;
+    }
+    return true;
+}
+
+uint8_t hexNibble(char _c) {
+    return (uint8_t) (_c <= '9' ? _c - '0' : _c - 'a' + 10);
+}
+
+uint8_t decimalNibble(char _c) {
+    return (uint8_t) (_c == ':' ? 10 : _c - '0');
+}
+
+}
+
+
+bool BinaryHeaderCodec::isBinary(const uint8_t *_data, size_t _len) {
+    return _len > 0 && _data[0] == BINARY_HEADER_VERSION;
+}
+
+
+void BinaryHeaderCodec::writeVarint(vector<uint8_t> &_out, uint64_t _value) {
+    while (_value >= 0x80) {
+        _out.push_back((uint8_t) (_value | 0x80));
+        _value >>= 7;
+    }
+    _out.push_back((uint8_t) _value);
+}
+
+
+uint64_t BinaryHeaderCodec::readVarint(const uint8_t *_data, size_t _len, size_t &_pos) {
+
+    uint64_t result = 0;
+
+    for (uint32_t shift = 0; shift < 64; shift += 7) {
+
+        if (_pos >= _len) {
+            BOOST_THROW_EXCEPTION(ParsingException("Truncated varint in binary header", __CLASS_NAME__));
+        }
+
+        auto b = _data[_pos++];
+
+        result |= ((uint64_t) (b & 0x7F)) << shift;
+
+        if ((b & 0x80) == 0)
+            return result;
+    }
+
+    BOOST_THROW_EXCEPTION(ParsingException("Varint too long in binary header", __CLASS_NAME__));
+}
+
+
+void BinaryHeaderCodec::writeString(vector<uint8_t> &_out, const string &_s) {
+    writeVarint(_out, _s.size());
+    _out.insert(_out.end(), _s.begin(), _s.end());
+}
+
+
+string BinaryHeaderCodec::readString(const uint8_t *_data, size_t _len, size_t &_pos) {
+
+    auto size = readVarint(_data, _len, _pos);
+
+    if (size > _len - _pos) {
+        BOOST_THROW_EXCEPTION(ParsingException("Truncated string in binary header", __CLASS_NAME__));
+    }
+
+    string result((const char *) _data + _pos, size);
+
+    _pos += size;
+
+    return result;
+}
+
+
+uint64_t BinaryHeaderCodec::fieldID(const string &_name) {
+
+    static const map<string, uint64_t> ids = [] {
+        map<string, uint64_t> m;
+        for (uint64_t i = 0; i < FIELD_NAMES.size(); i++) {
+            m[FIELD_NAMES[i]] = i + 1;
+        }
+        return m;
+    }();
+
+    auto it = ids.find(_name);
+
+    return it == ids.end() ? 0 : it->second;
+}
+
+
+void BinaryHeaderCodec::writeValue(vector<uint8_t> &_out, const nlohmann::json &_value) {
+
+    if (_value.is_number_unsigned()) {
+        _out.push_back(BH_UINT);
+        writeVarint(_out, _value.get<uint64_t>());
+    } else if (_value.is_number_integer()) {
+        auto v = _value.get<int64_t>();
+        if (v >= 0) {
+            _out.push_back(BH_UINT);
+            writeVarint(_out, (uint64_t) v);
+        } else {
+            _out.push_back(BH_NEGATIVE_INT);
+            writeVarint(_out, (uint64_t) (-(v + 1)));
+        }
+    } else if (_value.is_string()) {
+
+        auto &s = _value.get_ref<const string &>();
+
+        if (isHex(s)) {
+            _out.push_back(BH_HEX_STRING);
+            writeVarint(_out, s.size() / 2);
+            for (size_t i = 0; i < s.size(); i += 2) {
+                _out.push_back((uint8_t) ((hexNibble(s[i]) << 4) | hexNibble(s[i + 1])));
+            }
+        } else if (isDecimal(s)) {
+            _out.push_back(BH_DECIMAL_STRING);
+            writeVarint(_out, s.size());
+            for (size_t i = 0; i < s.size(); i += 2) {
+                uint8_t low = (i + 1 < s.size()) ? decimalNibble(s[i + 1]) : 0x0F;
+                _out.push_back((uint8_t) ((decimalNibble(s[i]) << 4) | low));
+            }
+        } else {
+            _out.push_back(BH_STRING);
+            writeString(_out, s);
+        }
+
+    } else if (_value.is_array() &&
+               all_of(_value.begin(), _value.end(), [](const nlohmann::json &_v) {
+                   return _v.is_number_unsigned() || (_v.is_number_integer() && _v.get<int64_t>() >= 0);
+               })) {
+        _out.push_back(BH_UINT_ARRAY);
+        writeVarint(_out, _value.size());
+        for (auto &&item : _value) {
+            writeVarint(_out, item.get<uint64_t>());
+        }
+    } else if (_value.is_boolean()) {
+        _out.push_back(_value.get<bool>() ? BH_TRUE : BH_FALSE);
+    } else if (_value.is_null()) {
+        _out.push_back(BH_NULL);
+    } else {
+        // anything else keeps its JSON representation
+        _out.push_back(BH_JSON);
+        writeString(_out, _value.dump());
+    }
+}
+
+
+nlohmann::json BinaryHeaderCodec::readValue(const uint8_t *_data, size_t _len, size_t &_pos) {
+
+    if (_pos >= _len) {
+        BOOST_THROW_EXCEPTION(ParsingException("Truncated value in binary header", __CLASS_NAME__));
+    }
+
+    auto type = _data[_pos++];
+
+    switch (type) {
+        case BH_UINT:
+            return readVarint(_data, _len, _pos);
+        case BH_NEGATIVE_INT: {
+            auto magnitude = readVarint(_data, _len, _pos);
+            // the writer only produces magnitudes up to INT64_MAX, anything above would overflow
+            if (magnitude > (uint64_t) INT64_MAX) {
+                BOOST_THROW_EXCEPTION(ParsingException("Negative integer out of range in binary header",
+                                                       __CLASS_NAME__));
+            }
+            return -((int64_t) magnitude) - 1;
+        }
+        case BH_STRING:
+            return readString(_data, _len, _pos);
+        case BH_HEX_STRING: {
+            static const char hexval[] = "0123456789abcdef";
+            auto size = readVarint(_data, _len, _pos);
+            if (size > _len - _pos) {
+                BOOST_THROW_EXCEPTION(ParsingException("Truncated hex string in binary header", __CLASS_NAME__));
+            }
+            string s(2 * size, '0');
+            for (uint64_t i = 0; i < size; i++) {
+                s[2 * i] = hexval[_data[_pos] >> 4];
+                s[2 * i + 1] = hexval[_data[_pos] & 0x0F];
+                _pos++;
+            }
+            return s;
+        }
+        case BH_DECIMAL_STRING: {
+            auto size = readVarint(_data, _len, _pos);
+            // two digits per byte, compared without arithmetic on the untrusted size
+            if (size > 2 * (_len - _pos)) {
+                BOOST_THROW_EXCEPTION(ParsingException("Truncated decimal string in binary header",
+                                                       __CLASS_NAME__));
+            }
+            string s(size, '0');
+            for (uint64_t i = 0; i < size; i++) {
+                uint8_t nibble = (i % 2 == 0) ? (_data[_pos] >> 4) : (_data[_pos] & 0x0F);
+                if (nibble > 10) {
+                    BOOST_THROW_EXCEPTION(ParsingException("Invalid decimal string in binary header", __CLASS_NAME__));
+                }
+                s[i] = DECIMAL_SYMBOLS[nibble];
+                if (i % 2 == 1)
+                    _pos++;
+            }
+            if (size % 2 == 1)
+                _pos++;
+            return s;
+        }
+        case BH_UINT_ARRAY: {
+            auto count = readVarint(_data, _len, _pos);
+            // every element takes at least one byte
+            if (count > _len - _pos) {
+                BOOST_THROW_EXCEPTION(ParsingException("Truncated array in binary header", __CLASS_NAME__));
+            }
+            nlohmann::json array = nlohmann::json::array();
+            auto &items = array.get_ref<nlohmann::json::array_t &>();
+            items.reserve(count);
+            for (uint64_t i = 0; i < count; i++) {
+                items.emplace_back(readVarint(_data, _len, _pos));
+            }
+            return array;
+        }
+        case BH_FALSE:
+            return false;
+        case BH_TRUE:
+            return true;
+        case BH_NULL:
+            return nullptr;
+        case BH_JSON: {
+            auto s = readString(_data, _len, _pos);
+            try {
+                return nlohmann::json::parse(s);
+            } catch (...) {
+                BOOST_THROW_EXCEPTION(ParsingException("Could not parse JSON value in binary header", __CLASS_NAME__));
+            }
+        }
+        default:
+            BOOST_THROW_EXCEPTION(ParsingException("Unknown value type in binary header:" + to_string(type),
+                                                   __CLASS_NAME__));
+    }
+}
+
+
+void BinaryHeaderCodec::encode(const nlohmann::json &_j, vector<uint8_t> &_out) {
+
+    ASSERT(_j.is_object());
+
+    _out.push_back(BINARY_HEADER_VERSION);
+
+    writeVarint(_out, _j.size());
+
+    for (auto it = _j.begin(); it != _j.end(); ++it) {
+
+        auto id = fieldID(it.key());
+
+        writeVarint(_out, id);
+
+        if (id == 0) {
+            writeString(_out, it.key());
+        }
+
+        writeValue(_out, it.value());
+    }
+}
+
+
+nlohmann::json BinaryHeaderCodec::decode(const uint8_t *_data, size_t _len) {
+
+    if (!isBinary(_data, _len)) {
+        BOOST_THROW_EXCEPTION(ParsingException("Unsupported binary header version", __CLASS_NAME__));
+    }
+
+    size_t pos = 1;
+
+    auto fieldCount = readVarint(_data, _len, pos);
+
+    nlohmann::json result = nlohmann::json::object();
+
+    for (uint64_t i = 0; i < fieldCount; i++) {
+
+        auto id = readVarint(_data, _len, pos);
+
+        string name;
+
+        if (id == 0) {
+            name = readString(_data, _len, pos);
+        } else if (id <= FIELD_NAMES.size()) {
+            name = FIELD_NAMES[id - 1];
+        } else {
+            BOOST_THROW_EXCEPTION(ParsingException("Unknown field id in binary header:" + to_string(id),
+                                                   __CLASS_NAME__));
+        }
+
+        result[name] = readValue(_data, _len, pos);
+    }
+
+    if (pos != _len) {
+        BOOST_THROW_EXCEPTION(ParsingException("Trailing bytes in binary header", __CLASS_NAME__));
+    }
+
+    return result;
+}
@@ -0,0 +1,59 @@
+/*
+    Copyright (C) 2018-2019 SKALE Labs
+
+    This file is part of skale-consensus.
+
+    skale-consensus is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    skale-consensus is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with skale-consensus.  If not, see <http://www.gnu.org/licenses/>.
+
+    @file BinaryHeaderCodec.h
+    @author Stan Kladko
+    @date 2018
+*/
+
+
+#pragma once
+
+
+/**
+ * Compact binary encoding of protocol headers, used instead of JSON text on connections where
+ * both sides support it. The first byte is the format version and can never be '{', so a
+ * reader tells the two formats apart without extra framing.
+ *
+ * Field names come from a fixed dictionary, integers and integer arrays are varints, and
+ * hex and decimal strings are packed two characters per byte.
+ */
+class BinaryHeaderCodec {
+
+    static void writeVarint(vector<uint8_t> &_out, uint64_t _value);
+
+    static uint64_t readVarint(const uint8_t *_data, size_t _len, size_t &_pos);
+
+    static void writeString(vector<uint8_t> &_out, const string &_s);
+
+    static string readString(const uint8_t *_data, size_t _len, size_t &_pos);
+
+    static void writeValue(vector<uint8_t> &_out, const nlohmann::json &_value);
+
+    static nlohmann::json readValue(const uint8_t *_data, size_t _len, size_t &_pos);
+
+    static uint64_t fieldID(const string &_name);
+
+public:
+
+    static bool isBinary(const uint8_t *_data, size_t _len);
+
+    static void encode(const nlohmann::json &_j, vector<uint8_t> &_out);
+
+    static nlohmann::json decode(const uint8_t *_data, size_t _len);
+};
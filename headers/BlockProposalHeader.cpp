@@ -47,6 +47,7 @@ BlockProposalHeader::BlockProposalHeader(Schain &_sChain, ptr<BlockProposal> pro
     this->proposerNodeID = _sChain.getNode()->getNodeID();
     this->partialHashesCount = (uint64_t) proposal->getTransactionsCount();
     this->timeStamp = proposal->getTimeStamp();
+    this->timeStampMs = proposal->getTimeStampMs();
     this->hash = proposal->getHash()->toHex();
 
 
@@ -75,6 +76,8 @@ void BlockProposalHeader::addFields(nlohmann::basic_json<> &jsonRequest) {
 
     jsonRequest["timeStamp"] = timeStamp;
 
+    jsonRequest["timeStampMs"] = timeStampMs;
+
     jsonRequest["hash"] = *hash;
 
 }
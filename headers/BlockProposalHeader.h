@@ -36,6 +36,7 @@ class BlockProposalHeader : public AbstractBlockRequestHeader{
 
     uint64_t partialHashesCount;
     uint64_t  timeStamp = 0;
+    uint32_t  timeStampMs = 0;
 
 public:
 
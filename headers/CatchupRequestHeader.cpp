@@ -49,6 +49,12 @@ CatchupRequestHeader::CatchupRequestHeader() : Header() {
 }
 
 CatchupRequestHeader::CatchupRequestHeader(Schain &_sChain, schain_index _dstIndex) :
+        CatchupRequestHeader(_sChain, _dstIndex, _sChain.getCommittedBlockID(),
+                             _sChain.getNode()->getCatchupChunkBlocks()) {
+}
+
+CatchupRequestHeader::CatchupRequestHeader(Schain &_sChain, schain_index _dstIndex, block_id _blockID,
+                                           uint64_t _maxBlocks) :
         Header() {
 
 
@@ -57,7 +63,9 @@ CatchupRequestHeader::CatchupRequestHeader(Schain &_sChain, schain_index _dstInd
     this->dstSchainIndex = _dstIndex;
     this->dstNodeID = _sChain.getNode()->getNodeInfoByIndex(_dstIndex)->getNodeID();
     this->schainID = _sChain.getSchainID();
-    this->blockID = _sChain.getCommittedBlockID();
+    this->blockID = _blockID;
+    this->maxBlocks = _maxBlocks;
+    this->maxBytes = _sChain.getNode()->getCatchupChunkBytes();
 
     ASSERT(_sChain.getNode()->getNodeInfosByIndex().count(_dstIndex) > 0);
 
@@ -79,6 +87,11 @@ void CatchupRequestHeader::addFields(nlohmann::basic_json<> &j) {
 
     j["blockID"] = (uint64_t ) blockID;
 
+    // asks the server to stream at most this much, the client resumes from its new committed block
+    j["maxBlocks"] = maxBlocks;
+
+    j["maxBytes"] = maxBytes;
+
 }
 
 
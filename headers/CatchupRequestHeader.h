@@ -41,6 +41,8 @@ class CatchupRequestHeader : public Header{
     schain_index srcSchainIndex;
     schain_index dstSchainIndex;
     block_id blockID;
+    uint64_t maxBlocks = 0;
+    uint64_t maxBytes = 0;
 
 public:
 
@@ -49,6 +51,11 @@ public:
 
     CatchupRequestHeader(Schain &_sChain, schain_index _dstIndex);
 
+    /**
+     * Requests at most _maxBlocks blocks following _blockID
+     */
+    CatchupRequestHeader(Schain &_sChain, schain_index _dstIndex, block_id _blockID, uint64_t _maxBlocks);
+
 
     void addFields(nlohmann::basic_json<> &j) override;
 
@@ -52,12 +52,18 @@ void CatchupResponseHeader::addFields(nlohmann::basic_json<> &_j) {
 
     _j["count"] = blockCount;
 
+    _j["committedBlockID"] = committedBlockID;
+
     if (blockSizes != nullptr)
         _j["sizes"] = *blockSizes;
 
 
 }
 
+void CatchupResponseHeader::setCommittedBlockID(uint64_t _committedBlockID) {
+    committedBlockID = _committedBlockID;
+}
+
 uint64_t CatchupResponseHeader::getBlockCount() const {
     return blockCount;
 }
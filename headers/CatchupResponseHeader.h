@@ -48,6 +48,8 @@ public:
 private:
     uint64_t blockCount = 0;
 
+    uint64_t committedBlockID = 0;
+
     ptr<list<uint64_t>> blockSizes = nullptr;
 
 public:
@@ -58,6 +60,8 @@ public:
 
     void setBlockSizes(ptr<list<uint64_t>> _blockSizes);
 
+    void setCommittedBlockID(uint64_t _committedBlockID);
+
     void addFields(nlohmann::basic_json<> &j_) override;
 
 };
@@ -52,6 +52,7 @@ CommittedBlockHeader::CommittedBlockHeader(CommittedBlock& _block) {
     this->blockID = _block.getBlockID();
     this->blockHash = _block.getHash();
     this->timeStamp = _block.getTimeStamp();
+    this->timeStampMs = _block.getTimeStampMs();
 
     auto items = _block.getTransactionList()->getItems();
 
@@ -91,6 +92,8 @@ void CommittedBlockHeader::addFields(nlohmann::basic_json<> &j) {
 
     j["timeStamp"] = timeStamp;
 
+    j["timeStampMs"] = timeStampMs;
+
     ASSERT(timeStamp > 0);
 
 
@@ -41,6 +41,7 @@ class CommittedBlockHeader : public Header {
     ptr<SHAHash> blockHash;
     list<uint32_t> transactionSizes;
     uint64_t timeStamp = 0;
+    uint32_t timeStampMs = 0;
 
 public:
 
@@ -35,6 +35,7 @@
 #include "../network/Buffer.h"
 #include "../network/IO.h"
 
+#include "BinaryHeaderCodec.h"
 #include "Header.h"
 
 
@@ -43,7 +44,7 @@ bool Header::isComplete() const {
     return complete;
 }
 
-ptr<Buffer> Header::toBuffer() {
+ptr<Buffer> Header::toBuffer(bool _binary) {
     ASSERT(complete);
     nlohmann::json j;
 
@@ -53,6 +54,21 @@ ptr<Buffer> Header::toBuffer() {
 
     addFields(j);
 
+    if (_binary) {
+
+        vector<uint8_t> bytes;
+
+        BinaryHeaderCodec::encode(j, bytes);
+
+        uint64_t len = bytes.size();
+
+        auto buf = make_shared<Buffer>(len + sizeof(uint64_t));
+        buf->write(&len, sizeof(len));
+        buf->write(bytes.data(), bytes.size());
+
+        return buf;
+    }
+
     string s = j.dump();
 
     uint64_t len = s.size();
@@ -88,6 +104,21 @@ ptr<string> Header::getString(nlohmann::json &_js, const char *_name) {
     return make_shared<string>(result);
 }
 
+uint32_t Header::getTimeStampMs(nlohmann::json &_js) {
+
+    if (_js.find("timeStampMs") == _js.end()) {
+        return 0;
+    }
+
+    auto result = getUint64(_js, "timeStampMs");
+
+    if (result >= 1000) {
+        BOOST_THROW_EXCEPTION(NetworkProtocolException("Invalid timeStampMs " + to_string(result), __CLASS_NAME__));
+    }
+
+    return (uint32_t) result;
+}
+
 Header::Header() {
 
     totalObjects++;
@@ -62,7 +62,10 @@ public:
     static void nullCheck( nlohmann::json& js, const char* name );
 
 
-    ptr< Buffer > toBuffer();
+    /**
+     * Serializes the header as JSON, or in BinaryHeaderCodec format if the peer supports it
+     */
+    ptr< Buffer > toBuffer( bool _binary = false );
 
 
     virtual void addFields(nlohmann::json & /*j*/ ) { };
@@ -71,6 +74,9 @@ public:
 
     static ptr< string > getString( nlohmann::json& _js, const char* _name );
 
+    // millisecond part of a block time stamp, zero for blocks created before it was introduced
+    static uint32_t getTimeStampMs( nlohmann::json& _js );
+
 
     ConnectionStatus getStatus() { return status; }
 
@@ -0,0 +1,136 @@
+/*
+    Copyright (C) 2018-2019 SKALE Labs
+
+    This file is part of skale-consensus.
+
+    skale-consensus is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    skale-consensus is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with skale-consensus.  If not, see <http://www.gnu.org/licenses/>.
+
+    @file ClientConnectionPool.cpp
+    @author Stan Kladko
+    @date 2018
+*/
+
+
+#include <poll.h>
+
+#include "../SkaleConfig.h"
+#include "../Log.h"
+#include "../exceptions/FatalError.h"
+#include "../exceptions/ExitRequestedException.h"
+#include "../exceptions/ConnectionRefusedException.h"
+
+#include "../thirdparty/json.hpp"
+#include "../chains/Schain.h"
+#include "../node/Node.h"
+#include "ClientSocket.h"
+#include "ClientConnectionPool.h"
+
+
+ClientConnectionPool::ClientConnectionPool(Schain &_sChain) : sChain(_sChain) {}
+
+
+bool ClientConnectionPool::isAlive(const ptr<ClientSocket> &_socket) {
+
+    // an idle connection never has anything to read, so readability means the peer closed it
+
+    struct pollfd fd;
+    fd.fd = (int) _socket->getDescriptor();
+    fd.events = POLLIN | POLLRDHUP;
+    fd.revents = 0;
+
+    return poll(&fd, 1, 0) == 0;
+}
+
+
+ptr<ClientSocket> ClientConnectionPool::connect(schain_index _dstIndex, port_type _portType) {
+
+    try {
+        auto socket = make_shared<ClientSocket>(sChain, _dstIndex, _portType);
+        socket->setPersistent(true);
+
+        lock_guard<mutex> lock(poolMutex);
+        peers[{_dstIndex, _portType}].failures = 0;
+
+        return socket;
+
+    } catch (ConnectionRefusedException &) {
+
+        lock_guard<mutex> lock(poolMutex);
+
+        auto &peer = peers[{_dstIndex, _portType}];
+
+        auto backoff = sChain.getNode()->getWaitAfterNetworkErrorMs() << min(peer.failures, (uint64_t) 16);
+
+        peer.failures++;
+        peer.nextConnectAttemptMs = Schain::getCurrentTimeMs() + min(backoff, MAX_RECONNECT_BACKOFF_MS);
+
+        throw;
+    }
+}
+
+
+ptr<ClientSocket> ClientConnectionPool::acquire(schain_index _dstIndex, port_type _portType) {
+
+    {
+        lock_guard<mutex> lock(poolMutex);
+
+        auto &peer = peers[{_dstIndex, _portType}];
+
+        while (!peer.idleSockets.empty()) {
+
+            auto socket = peer.idleSockets.front();
+            peer.idleSockets.pop_front();
+
+            if (isAlive(socket)) {
+                return socket;
+            }
+
+            LOG(debug, "Dropping closed pooled connection to:" + to_string(_dstIndex));
+        }
+
+        if (Schain::getCurrentTimeMs() < peer.nextConnectAttemptMs) {
+            BOOST_THROW_EXCEPTION(ConnectionRefusedException("Waiting before reconnecting to peer:" +
+                                                             to_string(_dstIndex), ECONNREFUSED, __CLASS_NAME__));
+        }
+    }
+
+    return connect(_dstIndex, _portType);
+}
+
+
+void ClientConnectionPool::release(const ptr<ClientSocket> &_socket) {
+
+    // the peer does not keep the connection open after a request
+    if (!_socket->isPersistent())
+        return;
+
+    lock_guard<mutex> lock(poolMutex);
+
+    auto &peer = peers[{_socket->getDestinationIndex(), _socket->getPortType()}];
+
+    if (peer.idleSockets.size() < MAX_POOLED_CONNECTIONS_PER_PEER) {
+        peer.idleSockets.push_back(_socket);
+    }
+}
+
+
+void ClientConnectionPool::warmUp(schain_index _dstIndex, port_type _portType) {
+    try {
+        release(acquire(_dstIndex, _portType));
+    } catch (ExitRequestedException &) {
+        throw;
+    } catch (Exception &e) {
+        LOG(debug, "Could not pre-open connection to:" + to_string(_dstIndex));
+    }
+}
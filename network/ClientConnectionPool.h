@@ -0,0 +1,77 @@
+/*
+    Copyright (C) 2018-2019 SKALE Labs
+
+    This file is part of skale-consensus.
+
+    skale-consensus is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    skale-consensus is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with skale-consensus.  If not, see <http://www.gnu.org/licenses/>.
+
+    @file ClientConnectionPool.h
+    @author Stan Kladko
+    @date 2018
+*/
+
+
+#pragma once
+
+
+class Schain;
+class ClientSocket;
+
+
+/**
+ * Long-lived client connections to peers, shared by all request types that go to the same port.
+ * A connection is handed out to one request at a time and returned to the pool once the
+ * request/response exchange completed. Failed connects are retried with exponential backoff.
+ */
+class ClientConnectionPool {
+
+    class PeerConnections {
+    public:
+        deque<ptr<ClientSocket>> idleSockets;
+
+        uint64_t failures = 0;
+
+        uint64_t nextConnectAttemptMs = 0;
+    };
+
+    Schain &sChain;
+
+    mutex poolMutex;
+
+    map<pair<schain_index, port_type>, PeerConnections> peers;
+
+    static bool isAlive(const ptr<ClientSocket> &_socket);
+
+    ptr<ClientSocket> connect(schain_index _dstIndex, port_type _portType);
+
+public:
+
+    explicit ClientConnectionPool(Schain &_sChain);
+
+    /**
+     * Returns an idle connection to the peer or opens a new one
+     */
+    ptr<ClientSocket> acquire(schain_index _dstIndex, port_type _portType);
+
+    /**
+     * Returns a connection after a completed exchange. Connections that failed must not be released,
+     * non-persistent ones are dropped
+     */
+    void release(const ptr<ClientSocket> &_socket);
+
+    /**
+     * Opens a connection in advance so that the first request does not pay for the handshake
+     */
+    void warmUp(schain_index _dstIndex, port_type _portType);
+};
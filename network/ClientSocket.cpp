@@ -63,6 +63,49 @@ ptr<sockaddr_in> ClientSocket::getSocketaddr() {
 }
 
 
+schain_index ClientSocket::getDestinationIndex() const {
+    return destinationIndex;
+}
+
+port_type ClientSocket::getPortType() const {
+    return portType;
+}
+
+bool ClientSocket::isPersistent() const {
+    return persistent;
+}
+
+void ClientSocket::setPersistent(bool _persistent) {
+    persistent = _persistent;
+}
+
+bool ClientSocket::isBinaryHeaders() const {
+    return binaryHeaders;
+}
+
+void ClientSocket::setBinaryHeaders(bool _binaryHeaders) {
+    binaryHeaders = _binaryHeaders;
+}
+
+bool ClientSocket::isNegotiated() const {
+    return negotiated;
+}
+
+uint64_t ClientSocket::getMagicFlags() const {
+    return magicFlags;
+}
+
+void ClientSocket::setNegotiatedFlags(uint64_t _flags) {
+    negotiated = true;
+    magicFlags = _flags;
+    persistent = (_flags & PERSISTENT_CONNECTION_FLAG) != 0;
+    // the server acknowledged that it reads binary headers, no need to wait for its first response
+    if ((_flags & BINARY_HEADERS_FLAG) != 0) {
+        binaryHeaders = true;
+    }
+}
+
+
 int ClientSocket::createTCPSocket() {
     int s;
 
@@ -70,6 +113,8 @@ int ClientSocket::createTCPSocket() {
         BOOST_THROW_EXCEPTION(FatalError("Could not create outgoing socket:" + string(strerror(errno))));
     }
 
+    Sockets::setTCPOptions(s, sendBufferSize, receiveBufferSize);
+
     if (::bind(s, (struct sockaddr *) bind_addr.get(), sizeof(sockaddr_in)) < 0) {
         close(s);
         BOOST_THROW_EXCEPTION(FatalError("Could not bind socket address" + string(strerror(errno))));
@@ -88,8 +133,10 @@ int ClientSocket::createTCPSocket() {
 }
 
 
-ClientSocket::ClientSocket(Schain &_sChain, schain_index _destinationIndex, port_type portType)
-        : bindIP(_sChain.getNode()->getBindIP()) {
+ClientSocket::ClientSocket(Schain &_sChain, schain_index _destinationIndex, port_type _portType)
+        : bindIP(_sChain.getNode()->getBindIP()), destinationIndex(_destinationIndex), portType(_portType),
+          sendBufferSize(_sChain.getNode()->getSocketSendBufferSize()),
+          receiveBufferSize(_sChain.getNode()->getSocketReceiveBufferSize()) {
     if (_sChain.getNode()->getNodeInfosByIndex().count(_destinationIndex) == 0) {
         BOOST_THROW_EXCEPTION(FatalError("Could not find node with destination index "));
     }
@@ -98,7 +145,7 @@ ClientSocket::ClientSocket(Schain &_sChain, schain_index _destinationIndex, port
 
 
     remoteIP = ni->getBaseIP();
-    remotePort = ni->getPort() + portType;
+    remotePort = ni->getPort() + _portType;
 
 
     this->remote_addr = Sockets::createSocketAddress(remoteIP, (uint16_t) remotePort);
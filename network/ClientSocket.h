@@ -46,6 +46,22 @@ class ClientSocket {
 
     ptr<sockaddr_in> bind_addr;
 
+    schain_index destinationIndex;
+
+    port_type portType;
+
+    uint64_t sendBufferSize;
+
+    uint64_t receiveBufferSize;
+
+    bool persistent = false;
+
+    bool binaryHeaders = false;
+
+    bool negotiated = false;
+
+    uint64_t magicFlags = 0;
+
 public:
 
 
@@ -57,6 +73,27 @@ public:
 
     ptr<sockaddr_in> getSocketaddr();
 
+    schain_index getDestinationIndex() const;
+
+    port_type getPortType() const;
+
+    bool isPersistent() const;
+
+    void setPersistent(bool _persistent);
+
+    bool isBinaryHeaders() const;
+
+    void setBinaryHeaders(bool _binaryHeaders);
+
+    /**
+     * True once the server acknowledged the capability flags, or they were not requested
+     */
+    bool isNegotiated() const;
+
+    uint64_t getMagicFlags() const;
+
+    void setNegotiatedFlags(uint64_t _flags);
+
 
     virtual ~ClientSocket() {
         closeSocket();
@@ -64,7 +101,7 @@ public:
 
     int createTCPSocket();
 
-    ClientSocket(Schain &_sChain, schain_index _destinationIndex, port_type portType);
+    ClientSocket(Schain &_sChain, schain_index _destinationIndex, port_type _portType);
 
     void closeSocket();
 
@@ -48,6 +48,39 @@ ptr<string> Connection::getIP() {
     return ip;
 }
 
+bool Connection::isPersistent() const {
+    return persistent;
+}
+
+void Connection::setPersistent(bool _persistent) {
+    persistent = _persistent;
+}
+
+bool Connection::isBinaryHeaders() const {
+    return binaryHeaders;
+}
+
+void Connection::setMagicFlags(uint64_t _flags) {
+    persistent = (_flags & PERSISTENT_CONNECTION_FLAG) != 0;
+    binaryHeaders = (_flags & BINARY_HEADERS_FLAG) != 0;
+}
+
+bool Connection::isFlagsAcknowledged() const {
+    return flagsAcknowledged;
+}
+
+void Connection::setFlagsAcknowledged(bool _flagsAcknowledged) {
+    flagsAcknowledged = _flagsAcknowledged;
+}
+
+uint64_t Connection::getIdleSinceMs() const {
+    return idleSinceMs;
+}
+
+void Connection::setIdleSinceMs(uint64_t _idleSinceMs) {
+    idleSinceMs = _idleSinceMs;
+}
+
 Connection::~Connection() {
     decrementTotalConnections();
     close((int)descriptor);
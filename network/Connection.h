@@ -32,6 +32,14 @@ class Connection {
     file_descriptor descriptor;
     ptr<string> ip;
 
+    bool persistent = false;
+
+    bool binaryHeaders = false;
+
+    bool flagsAcknowledged = false;
+
+    uint64_t idleSinceMs = 0;
+
 public:
 
     Connection(unsigned int descriptor, ptr<string>ip);
@@ -42,6 +50,25 @@ public:
 
     ptr<string> getIP();
 
+    bool isPersistent() const;
+
+    void setPersistent(bool _persistent);
+
+    bool isBinaryHeaders() const;
+
+    /**
+     * Applies the capability flags the client sent with the magic number
+     */
+    void setMagicFlags(uint64_t _flags);
+
+    bool isFlagsAcknowledged() const;
+
+    void setFlagsAcknowledged(bool _flagsAcknowledged);
+
+    uint64_t getIdleSinceMs() const;
+
+    void setIdleSinceMs(uint64_t _idleSinceMs);
+
     static void incrementTotalConnections();
 
     static void decrementTotalConnections();
@@ -32,6 +32,7 @@
 #include "../node/Node.h"
 #include "../headers/Header.h"
 #include "../headers/BlockProposalHeader.h"
+#include "../headers/BinaryHeaderCodec.h"
 #include "ClientSocket.h"
 #include "../exceptions/NetworkProtocolException.h"
 #include "../exceptions/IOException.h"
@@ -162,18 +163,84 @@ void IO::writeMagic(ptr<ClientSocket> _socket, bool _isPing) {
 
     if (_isPing) {
         magic = TEST_MAGIC_NUMBER;
-    } else {
-        magic = MAGIC_NUMBER;
+        writeBytes(_socket->getDescriptor(), (out_buffer *) &magic, sizeof(uint64_t));
+        return;
     }
 
-    try {
+    if (_socket->isNegotiated()) {
+        magic = MAGIC_NUMBER | _socket->getMagicFlags();
         writeBytes(_socket->getDescriptor(), (out_buffer *) &magic, sizeof(uint64_t));
-    } catch (ExitRequestedException &) { throw; }
+        return;
+    }
+
+    uint64_t flags = BINARY_HEADERS_FLAG;
+
+    if (_socket->isPersistent()) {
+        flags |= PERSISTENT_CONNECTION_FLAG;
+    }
+
+    if (isLegacyPeer(_socket->getDestinationIndex())) {
+        flags = 0;
+    }
+
+    magic = MAGIC_NUMBER | flags;
+
+    writeBytes(_socket->getDescriptor(), (out_buffer *) &magic, sizeof(uint64_t));
+
+    if (flags == 0) {
+        _socket->setNegotiatedFlags(0);
+        return;
+    }
+
+    uint64_t ack = 0;
 
+    try {
+        readBytes(_socket->getDescriptor(), (in_buffer *) &ack, msg_len(sizeof(ack)));
+    } catch (ExitRequestedException &) { throw; }
     catch (...) {
-        throw;
+        // an older server closes the connection on a magic number with flags
+        markLegacyPeer(_socket->getDestinationIndex());
+        _socket->setPersistent(false);
+        throw_with_nested(NetworkProtocolException("Peer did not acknowledge capability flags", __CLASS_NAME__));
+    }
+
+    if ((ack & ~MAGIC_FLAGS_MASK) != MAGIC_NUMBER) {
+        _socket->setPersistent(false);
+        BOOST_THROW_EXCEPTION(NetworkProtocolException("Incorrect magic acknowledgement" + to_string(ack),
+                                                       __CLASS_NAME__));
     }
 
+    _socket->setNegotiatedFlags(ack & flags);
+}
+
+
+bool IO::isLegacyPeer(schain_index _index) {
+
+    lock_guard<mutex> lock(legacyPeersMutex);
+
+    auto peer = legacyPeersUntilMs.find(_index);
+
+    if (peer == legacyPeersUntilMs.end())
+        return false;
+
+    if (Schain::getCurrentTimeMs() < peer->second)
+        return true;
+
+    legacyPeersUntilMs.erase(peer);
+
+    return false;
+}
+
+
+void IO::markLegacyPeer(schain_index _index) {
+
+    lock_guard<mutex> lock(legacyPeersMutex);
+
+    if (legacyPeersUntilMs.count(_index) == 0) {
+        LOG(info, "Peer " + to_string(_index) + " does not support capability flags, using plain requests");
+    }
+
+    legacyPeersUntilMs[_index] = Schain::getCurrentTimeMs() + LEGACY_PEER_RECHECK_MS;
 }
 
 
@@ -181,7 +248,7 @@ void IO::writeHeader(ptr<ClientSocket> socket, ptr<Header> header) {
     ASSERT(socket);
     ASSERT(header);
     ASSERT(header->isComplete());
-    writeBuf(socket->getDescriptor(), header->toBuffer());
+    writeBuf(socket->getDescriptor(), header->toBuffer(socket->isBinaryHeaders()));
 }
 
 void IO::writeBytesVector(file_descriptor socket, ptr<vector<uint8_t> > bytes) {
@@ -211,7 +278,7 @@ IO::IO(Schain *_sChain) : sChain(_sChain) {
 };
 
 
-void IO::readMagic(file_descriptor descriptor) {
+uint64_t IO::readMagic(file_descriptor descriptor) {
     uint64_t magic;
 
     try {
@@ -221,17 +288,51 @@ void IO::readMagic(file_descriptor descriptor) {
         throw_with_nested(NetworkProtocolException("Could not read magic number", __CLASS_NAME__));
     }
 
-    if (magic != MAGIC_NUMBER) {
+    if ((magic & ~MAGIC_FLAGS_MASK) != MAGIC_NUMBER) {
         if (magic == TEST_MAGIC_NUMBER) {
             BOOST_THROW_EXCEPTION(PingException("Got ping", __CLASS_NAME__));
         }
         BOOST_THROW_EXCEPTION(NetworkProtocolException("Incorrect magic number" + to_string(magic), __CLASS_NAME__));
     }
 
+    return magic & MAGIC_FLAGS_MASK;
 
 }
 
+void IO::readMagic(ptr<Connection> _connection) {
+
+    auto flags = readMagic(_connection->getDescriptor());
+
+    _connection->setMagicFlags(flags);
+
+    // the client waits for this before it sends the request, the server accepts all flags it knows
+    if (flags != 0 && !_connection->isFlagsAcknowledged()) {
+        uint64_t ack = MAGIC_NUMBER | flags;
+        writeBytes(_connection->getDescriptor(), (out_buffer *) &ack, msg_len(sizeof(ack)));
+        _connection->setFlagsAcknowledged(true);
+    }
+}
+
 nlohmann::json IO::readJsonHeader(file_descriptor descriptor, const char *_errorString) {
+    bool isBinary;
+    return readHeader(descriptor, _errorString, isBinary);
+}
+
+nlohmann::json IO::readJsonHeader(ptr<ClientSocket> _socket, const char *_errorString) {
+
+    bool isBinary;
+
+    auto js = readHeader(_socket->getDescriptor(), _errorString, isBinary);
+
+    // the server answered in binary, so it also reads binary headers
+    if (isBinary) {
+        _socket->setBinaryHeaders(true);
+    }
+
+    return js;
+}
+
+nlohmann::json IO::readHeader(file_descriptor descriptor, const char *_errorString, bool &_isBinary) {
 
 
     auto buf2 = make_shared<array<uint64_t, MAX_HEADER_SIZE>>();
@@ -272,6 +373,12 @@ nlohmann::json IO::readJsonHeader(file_descriptor descriptor, const char *_error
     }
 
 
+    _isBinary = BinaryHeaderCodec::isBinary(buf->getBuf()->data(), headerLen);
+
+    if (_isBinary) {
+        return BinaryHeaderCodec::decode(buf->getBuf()->data(), headerLen);
+    }
+
     auto s = make_shared<string>((const char *) buf->getBuf()->data(), (size_t) buf->getBuf()->size());
 
 
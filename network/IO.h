@@ -43,6 +43,18 @@ class IO {
 private:
 
     Schain *sChain;
+
+    mutex legacyPeersMutex;
+
+    /**
+     * Peers that did not acknowledge the capability flags, until when they get plain requests
+     */
+    map<schain_index, uint64_t> legacyPeersUntilMs;
+
+    bool isLegacyPeer(schain_index _index);
+
+    void markLegacyPeer(schain_index _index);
+
 public:
     IO(Schain *_sChain);
 
@@ -66,6 +78,11 @@ public:
 
 
 
+    /**
+     * On the first request of a connection the client asks for capability flags and waits for the
+     * server to acknowledge them. Older servers close the connection instead, then the peer gets plain
+     * single-request connections for LEGACY_PEER_RECHECK_MS
+     */
     void writeMagic(ptr<ClientSocket> _socket, bool _isPing = false);
 
     void writeBytesVector(file_descriptor socket, ptr<vector<uint8_t>> bytes);
@@ -74,10 +91,28 @@ public:
     void writePartialHashes(file_descriptor socket, ptr<map<uint64_t, ptr<partial_sha_hash>>> hashes);
 
 
-    void readMagic(file_descriptor descriptor);
+    /**
+     * Returns the capability flags the client sent with the magic number
+     */
+    uint64_t readMagic(file_descriptor descriptor);
+
+    /**
+     * Server side, applies the client flags to the connection and acknowledges them once per connection
+     */
+    void readMagic(ptr<Connection> _connection);
 
+    /**
+     * Reads a header in either JSON or binary encoding
+     */
     nlohmann::json readJsonHeader(file_descriptor descriptor, const char* _errorString);
 
+    /**
+     * Client side read, switches the socket to binary headers once the server replies in binary
+     */
+    nlohmann::json readJsonHeader(ptr<ClientSocket> _socket, const char* _errorString);
+
+    nlohmann::json readHeader(file_descriptor descriptor, const char* _errorString, bool &_isBinary);
+
 
 
 
@@ -21,6 +21,8 @@
     @date 2018
 */
 
+#include <netinet/tcp.h>
+
 #include "../SkaleConfig.h"
 #include "../Log.h"
 #include "../exceptions/FatalError.h"
@@ -70,6 +72,29 @@ ptr<sockaddr_in> Sockets::createSocketAddress(ptr<string>& ip, uint16_t port) {
     return ptr<sockaddr_in>(a);
 }
 
+void Sockets::setTCPOptions(int _descriptor, uint64_t _sendBufferSize, uint64_t _receiveBufferSize) {
+
+    int flag = 1;
+
+    if (setsockopt(_descriptor, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag)) < 0) {
+        LOG(warn, "Could not set TCP_NODELAY:" + string(strerror(errno)));
+    }
+
+    if (_sendBufferSize > 0) {
+        int size = (int) _sendBufferSize;
+        if (setsockopt(_descriptor, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)) < 0) {
+            LOG(warn, "Could not set SO_SNDBUF:" + string(strerror(errno)));
+        }
+    }
+
+    if (_receiveBufferSize > 0) {
+        int size = (int) _receiveBufferSize;
+        if (setsockopt(_descriptor, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) < 0) {
+            LOG(warn, "Could not set SO_RCVBUF:" + string(strerror(errno)));
+        }
+    }
+}
+
 Sockets::Sockets(Node &node) : node(node) {}
 
 Node &Sockets::getNode() const {
@@ -62,6 +62,11 @@ public:
 
     static ptr<sockaddr_in> createSocketAddress(ptr<string> &ip, uint16_t port);
 
+    /**
+     * Disables Nagle and applies socket buffer sizes, 0 keeps the kernel default
+     */
+    static void setTCPOptions(int _descriptor, uint64_t _sendBufferSize, uint64_t _receiveBufferSize);
+
     void initSockets(ptr<string> &bindIP, uint16_t basePort);
 
 };
@@ -56,63 +56,127 @@
 TransportType TransportNetwork::transport = TransportType::ZMQ;
 
 
-void TransportNetwork::addToDeferredMessageQueue(ptr<NetworkMessageEnvelope> _me) {
+bool TransportNetwork::addToDeferredMessageQueue(const ptr<NetworkMessageEnvelope> &_me, uint64_t _epoch) {
 
+    ASSERT(_me);
 
-    auto _blockID = _me->getMessage()->getBlockID();
+    auto m = dynamic_pointer_cast<NetworkMessage>(_me->getMessage());
 
-    LOG(trace, "Deferring::" + to_string(_blockID));
+    ASSERT(m);
 
-    ASSERT(_me);
+    auto peerIndex = _me->getSrcNodeInfo()->getSchainIndex();
 
-    ptr<vector<ptr<NetworkMessageEnvelope>>> messageList;
+    lock_guard<mutex> l(deferredMessageMutex);
 
-    {
-        lock_guard<recursive_mutex> l(deferredMessageMutex);
-
-        if (deferredMessageQueue.count(_blockID) == 0) {
-            messageList = make_shared<vector<ptr<NetworkMessageEnvelope>>>();
-            deferredMessageQueue[_blockID] = messageList;
-        } else {
-            messageList = deferredMessageQueue[_blockID];
-        };
+    if (_epoch != deferredReleaseEpoch) {
+        // a release happened after the caller checked, so the caller has to check again
+        return false;
+    }
 
-        messageList->push_back(_me);
+    if (deferredMessagesPerPeer[peerIndex] >= MAX_DEFERRED_MESSAGES_PER_PEER) {
+        LOG(debug, "Deferred message quota exceeded, dropping message from peer:" + to_string(peerIndex));
+        return true;
     }
 
+    LOG(trace, "Deferring::" + to_string(m->getBlockID()));
 
+    deferredMessages[m->getBlockID()][m->getBlockProposerIndex()][m->getRound()].push_back(_me);
+
+    deferredMessagesPerPeer[peerIndex]++;
+
+    return true;
 }
 
-ptr<vector<ptr<NetworkMessageEnvelope>>> TransportNetwork::pullMessagesForBlockID(block_id _blockID) {
 
+void TransportNetwork::pullRoundMessages(map<bin_consensus_round, vector<ptr<NetworkMessageEnvelope>>> &_rounds,
+                                         bin_consensus_round _maxRound,
+                                         vector<ptr<NetworkMessageEnvelope>> &_released) {
 
-    lock_guard<recursive_mutex> lock(deferredMessageMutex);
+    auto end = _rounds.upper_bound(_maxRound);
 
+    for (auto it = _rounds.begin(); it != end; it++) {
+        for (auto &&me : it->second) {
+            deferredMessagesPerPeer[me->getSrcNodeInfo()->getSchainIndex()]--;
+            _released.push_back(me);
+        }
+    }
 
-    auto returnList = make_shared<vector<ptr<NetworkMessageEnvelope>>>();
+    _rounds.erase(_rounds.begin(), end);
+}
 
 
-    for (auto it = deferredMessageQueue.cbegin();
-         it != deferredMessageQueue.cend() /* not hoisted */; /* no increment */) {
+void TransportNetwork::pullReleasedMessages(vector<ptr<NetworkMessageEnvelope>> &_released) {
 
-        if (it->first <= _blockID) {
+    // deferredMessageMutex is held by the caller
 
-            for (auto &&msg : *(it->second)) {
-                returnList->push_back(msg);
-            }
+    // past blocks go whole, messages of the current block only as their rounds are released
+    auto end = deferredMessages.lower_bound(releasedBlockID);
 
-            it = deferredMessageQueue.erase(it);
-        } else {
-            ++it;
+    for (auto it = deferredMessages.begin(); it != end; it++) {
+        for (auto &&proposer : it->second) {
+            pullRoundMessages(proposer.second, bin_consensus_round(UINT64_MAX), _released);
         }
+    }
+
+    deferredMessages.erase(deferredMessages.begin(), end);
+
+    for (auto &&r : releasedRounds) {
+
+        auto block = deferredMessages.find(get<0>(r));
 
+        if (block == deferredMessages.end())
+            continue;
 
+        auto proposer = block->second.find(get<1>(r));
+
+        if (proposer == block->second.end())
+            continue;
+
+        pullRoundMessages(proposer->second, get<2>(r), _released);
+
+        if (proposer->second.empty())
+            block->second.erase(proposer);
+
+        if (block->second.empty())
+            deferredMessages.erase(block);
     }
 
-    LOG(trace, "Pulling deferred BID::" + to_string(_blockID) + ":" + to_string(returnList->size()));
+    releasedRounds.clear();
+
+    LOG(trace, "Pulling deferred BID::" + to_string(releasedBlockID) + ":" + to_string(_released.size()));
+}
+
+
+void TransportNetwork::releaseDeferredMessages(block_id _blockID) {
+    {
+        lock_guard<mutex> l(deferredMessageMutex);
+        if (_blockID > releasedBlockID)
+            releasedBlockID = _blockID;
+        deferredReleaseEpoch++;
+        // every instance of the new block accepts the first round, later rounds wait for the instance
+        auto block = deferredMessages.find(_blockID);
+        if (block != deferredMessages.end()) {
+            for (auto &&proposer : block->second) {
+                releasedRounds.emplace_back(_blockID, proposer.first, bin_consensus_round(0));
+            }
+        }
+    }
+    deferredMessageCond.notify_all();
+}
 
-    return returnList;
 
+void TransportNetwork::releaseDeferredMessages(block_id _blockID, schain_index _proposerIndex,
+                                               bin_consensus_round _round) {
+    {
+        lock_guard<mutex> l(deferredMessageMutex);
+        deferredReleaseEpoch++;
+        auto block = deferredMessages.find(_blockID);
+        if (block == deferredMessages.end() || block->second.count(_proposerIndex) == 0)
+            return;
+        // messages for the next round are accepted once the instance decided
+        releasedRounds.emplace_back(_blockID, _proposerIndex, _round + 1);
+    }
+    deferredMessageCond.notify_all();
 }
 
 void TransportNetwork::broadcastMessage(Schain &subChain, ptr<NetworkMessage> m) {
@@ -125,73 +189,190 @@ void TransportNetwork::broadcastMessage(Schain &subChain, ptr<NetworkMessage> m)
     m->setIp(ip);
     node_id oldID = m->getDstNodeID();
 
-    unordered_set<uint64_t> sent;
+    vector<pair<schain_index, ptr<Buffer>>> buffers;
 
-    while (3 * (sent.size() + 1) < getSchain()->getNodeCount() * 2) {
+    for (auto const &it : subChain.getNode()->getNodeInfosByIndex()) {
+        if (it.second->getSchainIndex() != subChain.getSchainIndex()) {
+            m->setDstNodeID(it.second->getNodeID());
+            buffers.push_back({it.first, m->toBuffer()});
+        }
+    }
 
-        for (auto const &it : subChain.getNode()->getNodeInfosByIndex()) {
-            auto index = (uint64_t) it.second->getSchainIndex();
-            if (index != subChain.getSchainIndex() &&
-                !sent.count(index)) {
+    m->setDstNodeID(oldID);
 
-                m->setDstNodeID(it.second->getNodeID());
+    {
+        lock_guard<mutex> lock(outboundMutex);
 
-                ASSERT(it.second->getSchainIndex() != sChain->getSchainIndex());
+        for (auto &&item : buffers) {
+            auto &queue = outboundQueues[item.first];
+            queue.push_back(item.second);
+            trimOutboundQueue(item.first, queue);
+        }
 
-                if (sendMessage(it.second, m)) {
-                    sent.insert((uint64_t) it.second->getSchainIndex());
-                }
+        newOutboundMessages = true;
+    }
+
+    outboundCond.notify_one();
+}
+
+
+void TransportNetwork::outboundMessagesLoop() {
+
+    setThreadName(__CLASS_NAME__);
+
+    waitOnGlobalStartBarrier();
+
+    bool blocked = false;
+
+    // retry delay for peers that do not accept messages, doubles while they stay blocked
+    uint64_t retryDelayMs = 1;
+
+    try {
+
+        while (!getNode()->isExitRequested()) {
+
+            map<schain_index, deque<ptr<Buffer>>> messages;
+
+            bool arrived;
+
+            {
+                unique_lock<mutex> lock(outboundMutex);
+
+                // if some peer did not accept messages, retry it soon even if nothing new arrived
+                arrived = outboundCond.wait_for(lock, chrono::milliseconds(blocked ? retryDelayMs : 100), [this]() {
+                    return newOutboundMessages || getNode()->isExitRequested();
+                });
             }
 
-        }
-    }
+            // let the rest of the votes of the current step join the frame
+            if (arrived && getNode()->getConsensusBatchWindowUs() > 0) {
+                usleep(getNode()->getConsensusBatchWindowUs());
+            }
+
+            set<schain_index> peersWithFrames;
+
+            {
+                lock_guard<mutex> lock(outboundMutex);
+                newOutboundMessages = false;
+                messages.swap(outboundQueues);
+                peersWithFrames = framePeers;
+            }
+
+            bool wasBlocked = blocked;
 
-    if (sent.size() + 1 < getSchain()->getNodeCount()) {
-        for (auto const &it : subChain.getNode()->getNodeInfosByIndex()) {
-            auto index = (uint64_t) it.second->getSchainIndex();
-            if (index != subChain.getSchainIndex() && !sent.count(index)) {
-                {
-                    lock_guard<recursive_mutex> lock(delayedSendsLock);
-                    delayedSends[index].push_back({m, it.second});
-                    if (delayedSends[index].size() > 256) {
-                        delayedSends[index].pop_front();
+            blocked = false;
+
+            for (auto &&item : messages) {
+
+                auto nodeInfo = getNode()->getNodeInfosByIndex().at(item.first);
+                auto &queue = item.second;
+
+                auto maxCount = (getNode()->isConsensusFrames() || peersWithFrames.count(item.first) > 0) ?
+                                MAX_CONSENSUS_MESSAGES_PER_FRAME : 1;
+
+                while (!queue.empty()) {
+
+                    auto count = std::min((uint64_t) queue.size(), maxCount);
+
+                    try {
+                        if (!sendMessage(nodeInfo, packFrame(queue, count))) {
+                            break;
+                        }
+                    } catch (ExitRequestedException &) {
+                        throw;
+                    } catch (FatalError &) {
+                        throw;
+                    } catch (Exception &e) {
+                        Exception::log_exception(e);
                     }
+
+                    queue.erase(queue.begin(), queue.begin() + count);
+                }
+            }
+
+            lock_guard<mutex> lock(outboundMutex);
+
+            for (auto &&item : messages) {
+                if (item.second.empty()) {
+                    continue;
                 }
 
+                blocked = true;
+
+                // unsent messages go back in front of the ones queued in the meantime
+                auto &queue = outboundQueues[item.first];
+                queue.insert(queue.begin(), item.second.begin(), item.second.end());
+                trimOutboundQueue(item.first, queue);
+            }
+
+            if (!blocked) {
+                retryDelayMs = 1;
+            } else if (wasBlocked) {
+                retryDelayMs = std::min(2 * retryDelayMs, MAX_OUTBOUND_RETRY_BACKOFF_MS);
             }
         }
+    } catch (ExitRequestedException &) {
+    } catch (FatalError &e) {
+        getNode()->exitOnFatalError(e.getMessage());
+    }
+
+    getNode()->getSockets()->consensusZMQSocket->closeSend();
+}
 
 
+void TransportNetwork::trimOutboundQueue(schain_index _index, deque<ptr<Buffer>> &_queue) {
+
+    // a peer that does not read its messages can not make us run out of memory
+    if (_queue.size() <= MAX_OUTBOUND_MESSAGES_PER_PEER)
+        return;
+
+    auto dropped = _queue.size() - MAX_OUTBOUND_MESSAGES_PER_PEER;
+
+    _queue.erase(_queue.begin(), _queue.begin() + dropped);
+
+    auto &peerDropped = droppedOutboundMessages[_index];
+
+    // log on the first drop and then each time the count passes a power of two, to not flood the log
+    auto previous = peerDropped;
+    peerDropped += dropped;
+    droppedOutboundMessagesTotal += dropped;
+
+    if (previous == 0 || (previous ^ peerDropped) > previous) {
+        LOG(warn, "Outbound queue full, dropped " + to_string(peerDropped) +
+                  " consensus messages to peer " + to_string(_index));
     }
+}
 
-    m->
-            setDstNodeID(oldID);
 
-    for (
-        auto const &it
-            : subChain.getNode()->getNodeInfosByIndex()) {
-        if (it.second->
+uint64_t TransportNetwork::getDroppedOutboundMessages() const {
+    return droppedOutboundMessagesTotal;
+}
 
-                getSchainIndex()
 
-            != subChain.
+ptr<Buffer> TransportNetwork::packFrame(const deque<ptr<Buffer>> &_messages, size_t _count) {
 
-                getSchainIndex()
+    ASSERT(_count > 0 && _count <= _messages.size());
 
-                ) {
-            m->
-                    setDstNodeID(it
-                                         .second->
+    if (_count == 1) {
+        return _messages.front();
+    }
 
-                    getNodeID()
+    auto frame = make_shared<Buffer>(_count * CONSENSUS_MESSAGE_LEN);
 
-            );
-            confirmMessage(it
-                                   .second);
-        }
+    for (size_t i = 0; i < _count; i++) {
+        auto &message = _messages[i];
+        ASSERT(message->getCounter() == CONSENSUS_MESSAGE_LEN);
+        frame->write(message->getBuf()->data(), CONSENSUS_MESSAGE_LEN);
     }
 
+    return frame;
+}
+
 
+void TransportNetwork::notifyAllConditionVariables() {
+    Agent::notifyAllConditionVariables();
+    outboundCond.notify_all();
+    deferredMessageCond.notify_all();
 }
 
 void TransportNetwork::networkReadLoop() {
@@ -206,20 +387,22 @@ void TransportNetwork::networkReadLoop() {
 
             try {
 
-                ptr<NetworkMessageEnvelope> m = receiveMessage();
+                auto messages = receiveMessages();
 
-                if (!m)
+                if (!messages)
                     continue;           // check exit again
 
-                if (m->getMessage()->getBlockID() <= catchupBlocks) {
-                    continue;
-                }
+                for (auto &&m : *messages) {
 
-                ASSERT(sChain);
+                    if (m->getMessage()->getBlockID() <= catchupBlocks) {
+                        continue;
+                    }
 
-                block_id currentBlockID = sChain->getCommittedBlockID() + 1;
+                    ASSERT(sChain);
 
-                postOrDefer(m, currentBlockID);}
+                    postOrDefer(m);
+                }
+            }
             catch(ExitRequestedException&) {return;}
             catch (FatalError&)  {throw;}
             catch (Exception &e) {
@@ -240,67 +423,93 @@ void TransportNetwork::networkReadLoop() {
 
 }
 
-void TransportNetwork::postOrDefer(const ptr<NetworkMessageEnvelope> &m, const block_id &currentBlockID) {
-    if (m->getMessage()->getBlockID() > currentBlockID) {
-        addToDeferredMessageQueue(m);
-    } else if (m->getMessage()->getBlockID() <= currentBlockID) {
-        auto msg = (NetworkMessage *) m->getMessage().get();
-        if (msg->getRound() > sChain->getBlockConsensusInstance()->getRound(msg->createDestinationProtocolKey()) + 1) {
-            addToDeferredMessageQueue(m);
-        } else if (msg->getRound() ==
-                   sChain->getBlockConsensusInstance()->getRound(msg->createDestinationProtocolKey()) + 1 &&
-                   !sChain->getBlockConsensusInstance()->decided(msg->createDestinationProtocolKey())) {
-            addToDeferredMessageQueue(m);
-        } else {
+bool TransportNetwork::isReadyForProcessing(const ptr<NetworkMessageEnvelope> &_me) {
+
+    block_id currentBlockID = sChain->getCommittedBlockID() + 1;
+
+    auto m = (NetworkMessage *) _me->getMessage().get();
+
+    if (m->getBlockID() > currentBlockID)
+        return false;
+
+    auto key = m->createDestinationProtocolKey();
+
+    auto round = sChain->getBlockConsensusInstance()->getRound(key);
+
+    if (m->getRound() > round + 1)
+        return false;
+
+    if (m->getRound() == round + 1 && !sChain->getBlockConsensusInstance()->decided(key))
+        return false;
+
+    return true;
+}
+
+void TransportNetwork::postOrDefer(const ptr<NetworkMessageEnvelope> &m) {
+
+    while (true) {
+
+        uint64_t epoch;
+
+        {
+            lock_guard<mutex> l(deferredMessageMutex);
+            epoch = deferredReleaseEpoch;
+        }
+
+        if (isReadyForProcessing(m)) {
             sChain->postMessage(m);
+            return;
+        }
+
+        if (addToDeferredMessageQueue(m, epoch)) {
+            lagDetected(m);
+            return;
         }
-    } else {
-        sChain->postMessage(m);
     }
 }
 
+void TransportNetwork::lagDetected(const ptr<NetworkMessageEnvelope> &_me) {
+
+    auto blockID = (uint64_t) ((NetworkMessage *) _me->getMessage().get())->getBlockID();
+
+    // the sender has committed every block before the one it is voting on. A lag of one block
+    // is normal right after a commit, our own consensus usually catches up on its own
+    if (blockID < (uint64_t) sChain->getCommittedBlockID() + 1 + CATCHUP_LAG_THRESHOLD_BLOCKS)
+        return;
+
+    sChain->lagDetected(_me->getSrcNodeInfo()->getSchainIndex(), blockID - 1);
+}
+
+
 void TransportNetwork::deferredMessagesLoop() {
 
     setThreadName(__CLASS_NAME__);
 
     waitOnGlobalStartBarrier();
 
-    while (!getSchain()->getNode()->isExitRequested()) {
+    vector<ptr<NetworkMessageEnvelope>> released;
 
+    while (!getSchain()->getNode()->isExitRequested()) {
 
-        ptr<vector<ptr<NetworkMessageEnvelope>>> deferredMessages;
+        released.clear();
 
         {
+            unique_lock<mutex> lock(deferredMessageMutex);
 
-            block_id currentBlockID = sChain->getCommittedBlockID() + 1;
-
-            deferredMessages = pullMessagesForBlockID(currentBlockID);
-        }
+            // released messages are processed as soon as a block commits or a round advances
+            deferredMessageCond.wait_for(lock, std::chrono::milliseconds(1000), [this] {
+                return !releasedRounds.empty() ||
+                       (deferredMessages.size() > 0 && deferredMessages.begin()->first < releasedBlockID) ||
+                       getSchain()->getNode()->isExitRequested();
+            });
 
-        for (auto message: *deferredMessages) {
-            block_id currentBlockID = sChain->getCommittedBlockID() + 1;
-            postOrDefer(message, currentBlockID);
+            pullReleasedMessages(released);
         }
 
-
-        for (int i = 0; i < getSchain()->getNodeCount(); i++) {
-            if (i != getSchain()->getSchainIndex()) {
-                lock_guard<recursive_mutex> lock(delayedSendsLock);
-                if (delayedSends[i].size() > 0) {
-                    if (sendMessage(delayedSends[i].front().second, delayedSends[i].front().first)) {
-                        delayedSends[i].pop_front();
-                    }
-                }
-
-            }
+        for (auto &&message : released) {
+            postOrDefer(message);
         }
-
-
-        usleep(100000);
-
     }
-
-
 }
 
 
@@ -309,9 +518,11 @@ void TransportNetwork::startThreads() {
 
     networkReadThread = make_shared<thread>(std::bind(&TransportNetwork::networkReadLoop, this));
     deferredMessageThread = make_shared<thread>(std::bind(&TransportNetwork::deferredMessagesLoop, this));
+    outboundMessageThread = make_shared<thread>(std::bind(&TransportNetwork::outboundMessagesLoop, this));
 
     WorkerThreadPool::addThread(networkReadThread);
     WorkerThreadPool::addThread(deferredMessageThread);
+    WorkerThreadPool::addThread(outboundMessageThread);
 
 
 }
@@ -327,6 +538,7 @@ void TransportNetwork::waitUntilExit() {
 
     networkReadThread->join();
     deferredMessageThread->join();
+    outboundMessageThread->join();
 
 }
 
@@ -339,17 +551,52 @@ ptr<string> TransportNetwork::ipToString(uint32_t _ip) {
 
 }
 
-ptr<NetworkMessageEnvelope> TransportNetwork::receiveMessage() {
+ptr<vector<ptr<NetworkMessageEnvelope>>> TransportNetwork::receiveMessages() {
 
+    auto buf = make_shared<Buffer>(MAX_CONSENSUS_MESSAGES_PER_FRAME * CONSENSUS_MESSAGE_LEN);
 
-    auto buf = make_shared<Buffer>(sizeof(NetworkMessage));
-    auto ip = readMessageFromNetwork(buf);
+    uint64_t messageCount = 0;
 
+    auto ip = readMessageFromNetwork(buf, messageCount);
 
     if (ip == nullptr) {
         return nullptr;
     }
 
+    auto result = make_shared<vector<ptr<NetworkMessageEnvelope>>>();
+
+    for (uint64_t i = 0; i < messageCount; i++) {
+
+        auto m = parseMessage(buf, ip);
+
+        // a frame with a corrupt message is dropped from that message on
+        if (!m) {
+            break;
+        }
+
+        result->push_back(m);
+    }
+
+    if (messageCount > 1 && !result->empty()) {
+        addFramePeer(result->front()->getSrcNodeInfo()->getSchainIndex());
+    }
+
+    return result;
+}
+
+
+void TransportNetwork::addFramePeer(schain_index _index) {
+
+    lock_guard<mutex> lock(outboundMutex);
+
+    if (framePeers.insert(_index).second) {
+        LOG(info, "Peer " + to_string(_index) + " reads multi-message consensus frames");
+    }
+}
+
+
+ptr<NetworkMessageEnvelope> TransportNetwork::parseMessage(ptr<Buffer> buf, ptr<string> &ip) {
+
     uint64_t magicNumber;
     uint64_t sChainID;
     uint64_t blockID;
@@ -387,7 +634,11 @@ ptr<NetworkMessageEnvelope> TransportNetwork::receiveMessage() {
         ip = ip2;
     } else {
         LOG(debug, (*ip + ":" + *ip2).c_str());
-        ASSERT(*ip == *ip2);
+        // all messages of a frame come from one peer, the whole frame is dropped otherwise
+        if (*ip != *ip2) {
+            BOOST_THROW_EXCEPTION(InvalidMessageFormatException("Network messages from different ips in one frame",
+                                                                __CLASS_NAME__));
+        }
     }
 
 
@@ -407,7 +658,8 @@ ptr<NetworkMessageEnvelope> TransportNetwork::receiveMessage() {
                                                 bin_consensus_value(value),
                                                 schain_id(sChainID), msg_id(msgID), rawIP);
     } else {
-        ASSERT(false);
+        BOOST_THROW_EXCEPTION(InvalidMessageFormatException("Network message with unknown type " +
+                                                            to_string(msgType), __CLASS_NAME__));
     }
 
 
@@ -463,8 +715,7 @@ uint64_t TransportNetwork::getCatchupBlock() const {
 }
 
 
-TransportNetwork::TransportNetwork(Schain &_sChain) : Agent(_sChain, false),
-                                                      delayedSends((uint64_t) _sChain.getNodeCount()) {
+TransportNetwork::TransportNetwork(Schain &_sChain) : Agent(_sChain, false), droppedOutboundMessagesTotal(0) {
     auto cfg = _sChain.getNode()->getCfg();
 
     if (cfg.find("catchupBlocks") != cfg.end()) {
@@ -480,7 +731,3 @@ TransportNetwork::TransportNetwork(Schain &_sChain) : Agent(_sChain, false),
 
 
 }
-
-void TransportNetwork::confirmMessage(const ptr<NodeInfo> &) {
-
-};
@@ -41,14 +41,37 @@ enum TransportType {ZMQ};
 
 class TransportNetwork : public Agent  {
 
-    // used to test catchup
+    /**
+     * Per-peer queues of serialized messages, drained by the outbound thread
+     */
+    mutex outboundMutex;
+
+    condition_variable outboundCond;
 
-    recursive_mutex delayedSendsLock;
+    map<schain_index, deque<ptr<Buffer>>> outboundQueues;
 
-    vector<std::list<pair<ptr<NetworkMessage>,ptr<NodeInfo>>>> delayedSends;
+    /**
+     * Peers that sent us multi-message frames and so can read them, guarded by outboundMutex.
+     * Older peers only accept frames with a single message
+     */
+    set<schain_index> framePeers;
 
+    void addFramePeer(schain_index _index);
+
+    bool newOutboundMessages = false;
+
+    /**
+     * Messages dropped because a peer queue overflowed, per peer and in total
+     */
+    map<schain_index, uint64_t> droppedOutboundMessages;
+
+    atomic<uint64_t> droppedOutboundMessagesTotal;
+
+    /**
+     * Drops the oldest messages of a queue above the limit, outboundMutex must be held
+     */
+    void trimOutboundQueue(schain_index _index, deque<ptr<Buffer>> &_queue);
 
-    recursive_mutex deferredMutex;
 
     uint32_t packetLoss = 0;
 public:
@@ -67,28 +90,64 @@ protected:
 
     explicit TransportNetwork(Schain& _sChain);
     /**
-     * Mutex that controls access to inbox
+     * Mutex that controls access to deferred messages
+     */
+    mutex deferredMessageMutex;
+
+    condition_variable deferredMessageCond;
+
+    /**
+     * Messages that arrived too early, indexed by block, proposer and round
+     */
+    map<block_id, map<schain_index, map<bin_consensus_round, vector<ptr<NetworkMessageEnvelope>>>>>
+            deferredMessages;
+
+    map<schain_index, uint64_t> deferredMessagesPerPeer;
+
+    /**
+     * Incremented on every release, so that a message deferred on stale state is re-checked
      */
-    recursive_mutex deferredMessageMutex;
+    uint64_t deferredReleaseEpoch = 0;
 
-    map<block_id, ptr<vector<ptr<NetworkMessageEnvelope>>>> deferredMessageQueue;
+    /**
+     * Release requests not yet processed by the deferred messages thread. Blocks below releasedBlockID
+     * are released whole, releasedRounds holds the highest round to release for an instance
+     */
+    block_id releasedBlockID = 0;
 
-    void addToDeferredMessageQueue(ptr<NetworkMessageEnvelope> _me);
+    vector<tuple<block_id, schain_index, bin_consensus_round>> releasedRounds;
 
-    ptr<vector<ptr<NetworkMessageEnvelope>>> pullMessagesForBlockID(block_id _blockID);
+    bool addToDeferredMessageQueue(const ptr<NetworkMessageEnvelope> &_me, uint64_t _epoch);
 
+    bool isReadyForProcessing(const ptr<NetworkMessageEnvelope> &_me);
 
-    virtual bool sendMessage(const ptr<NodeInfo> &remoteNodeInfo, ptr<NetworkMessage> _msg) = 0;
+    /**
+     * Messages for blocks well ahead of ours mean the sender is ahead, start catchup from it
+     */
+    void lagDetected(const ptr<NetworkMessageEnvelope> &_me);
 
+    void pullReleasedMessages(vector<ptr<NetworkMessageEnvelope>> &_released);
 
-    virtual void confirmMessage(const ptr<NodeInfo> &remoteNodeInfo);
+    void pullRoundMessages(map<bin_consensus_round, vector<ptr<NetworkMessageEnvelope>>> &_rounds,
+                           bin_consensus_round _maxRound, vector<ptr<NetworkMessageEnvelope>> &_released);
 
 
+    /**
+     * Non-blocking send, returns false if the peer can not accept the message right now
+     */
+    virtual bool sendMessage(const ptr<NodeInfo> &remoteNodeInfo, ptr<Buffer> _buf) = 0;
+
+    ptr<Buffer> packFrame(const deque<ptr<Buffer>> &_messages, size_t _count);
+
+    ptr<NetworkMessageEnvelope> parseMessage(ptr<Buffer> _buf, ptr<string> &_ip);
+
 
     ptr<thread> networkReadThread;
 
     ptr<thread> deferredMessageThread;
 
+    ptr<thread> outboundMessageThread;
+
 
 public:
 
@@ -99,6 +158,10 @@ public:
 
     void networkReadLoop();
 
+    void outboundMessagesLoop();
+
+    void notifyAllConditionVariables() override;
+
     void waitUntilExit();
 
 
@@ -107,9 +170,12 @@ public:
 
     void broadcastMessage(Schain& _schain, ptr<NetworkMessage> _m);
 
-    ptr<NetworkMessageEnvelope> receiveMessage();
+    ptr<vector<ptr<NetworkMessageEnvelope>>> receiveMessages();
 
-    virtual ptr<string> readMessageFromNetwork(ptr<Buffer> buf) = 0;
+    /**
+     * Reads one frame of CONSENSUS_MESSAGE_LEN messages into the buffer and sets the number of messages read
+     */
+    virtual ptr<string> readMessageFromNetwork(ptr<Buffer> buf, uint64_t &_messageCount) = 0;
 
     static bool validateIpAddress(ptr<string> &_ip);
 
@@ -121,5 +187,18 @@ public:
 
     void setCatchupBlocks(uint64_t _catchupBlocks);
 
-    void postOrDefer(const ptr<NetworkMessageEnvelope> &m, const block_id &currentBlockID);
+    uint64_t getDroppedOutboundMessages() const;
+
+    void postOrDefer(const ptr<NetworkMessageEnvelope> &m);
+
+    /**
+     * Called with the new current block. Releases deferred messages for all blocks below _blockID
+     * and the first round of _blockID
+     */
+    void releaseDeferredMessages(block_id _blockID);
+
+    /**
+     * Releases deferred messages of a binary consensus instance that moved to _round or decided
+     */
+    void releaseDeferredMessages(block_id _blockID, schain_index _proposerIndex, bin_consensus_round _round);
 };
@@ -54,9 +54,7 @@
 using namespace std;
 
 
-bool ZMQNetwork::sendMessage(const ptr<NodeInfo> &_remoteNodeInfo, ptr<NetworkMessage> _msg) {
-
-    auto buf = _msg->toBuffer();
+bool ZMQNetwork::sendMessage(const ptr<NodeInfo> &_remoteNodeInfo, ptr<Buffer> _buf) {
 
     auto ip = _remoteNodeInfo->getBaseIP();
 
@@ -64,17 +62,11 @@ bool ZMQNetwork::sendMessage(const ptr<NodeInfo> &_remoteNodeInfo, ptr<NetworkMe
 
     void *s = sChain->getNode()->getSockets()->consensusZMQSocket->getDestinationSocket(ip, port);
 
-    auto len = buf->getCounter();
-
-    ASSERT(len == CONSENSUS_MESSAGE_LEN);
-
-#ifdef ZMQ_NONBLOCKING
-    return interruptableSend(s, buf->getBuf()->data(), len, true);
-#else
-    return interruptableSend(s, buf->getBuf()->data(), len, false);
-#endif
+    auto len = _buf->getCounter();
 
+    ASSERT(len > 0 && len % CONSENSUS_MESSAGE_LEN == 0);
 
+    return interruptableSend(s, _buf->getBuf()->data(), len, true);
 }
 
 
@@ -142,23 +134,19 @@ bool ZMQNetwork::interruptableSend(void *_socket, void *_buf, size_t _len, bool
 }
 
 
-ptr<string> ZMQNetwork::readMessageFromNetwork(ptr<Buffer> buf) {
+ptr<string> ZMQNetwork::readMessageFromNetwork(ptr<Buffer> buf, uint64_t &_messageCount) {
 
     auto s = sChain->getNode()->getSockets()->consensusZMQSocket->getReceiveSocket();
 
-    auto rc = interruptableRecv(s, buf->getBuf()->data(), sizeof(NetworkMessage), 0);
+    auto rc = interruptableRecv(s, buf->getBuf()->data(), buf->getSize(), 0);
 
 
-    if (rc != CONSENSUS_MESSAGE_LEN) {
+    if (rc <= 0 || (uint64_t) rc > buf->getSize() || rc % CONSENSUS_MESSAGE_LEN != 0) {
         throw NetworkProtocolException("Incorrect message length:" +
                                        to_string(rc), __CLASS_NAME__);
     }
 
-
-#ifndef ZMQ_EXPERIMENTAL
-    int zero = 0;
-    interruptableSend(s, &zero, 1, 0);
-#endif
+    _messageCount = rc / CONSENSUS_MESSAGE_LEN;
 
     return make_shared<string>("");
 
@@ -166,24 +154,3 @@ ptr<string> ZMQNetwork::readMessageFromNetwork(ptr<Buffer> buf) {
 
 
 ZMQNetwork::ZMQNetwork(Schain &_schain) : TransportNetwork(_schain) {}
-
-void ZMQNetwork::confirmMessage(const ptr<NodeInfo>&
-#ifndef ZMQ_EXPERIMENTAL
-                                remoteNodeInfo
-#endif
-) {
-
-
-#ifndef ZMQ_EXPERIMENTAL
-
-
-    auto ip = remoteNodeInfo->getBaseIP();
-
-    auto port = remoteNodeInfo->getPort();
-
-    void *s = sChain->getNode()->getSockets()->consensusZMQSocket->getDestinationSocket(ip, port);
-
-    char response[1];
-    interruptableRecv(s, response, 1, 0);
-#endif
-}
@@ -50,12 +50,10 @@ public:
 
     bool interruptableSend(void *_socket, void *_buf, size_t _len, bool _isNonBlocking = false);
 
-    ptr<string> readMessageFromNetwork(ptr<Buffer> buf);
+    ptr<string> readMessageFromNetwork(ptr<Buffer> buf, uint64_t &_messageCount) override;
 
     ZMQNetwork(Schain &_schain);
 
-    bool sendMessage(const ptr<NodeInfo> &_remoteNodeInfo, ptr<NetworkMessage> _msg);
-
-    virtual void confirmMessage(const ptr<NodeInfo> &remoteNodeInfo);
+    bool sendMessage(const ptr<NodeInfo> &_remoteNodeInfo, ptr<Buffer> _buf) override;
 };
 
@@ -46,17 +46,19 @@ void *ZMQServerSocket::getDestinationSocket(ptr<string> _ip, network_port _baseP
 #ifdef ZMQ_EXPERIMENTAL
     void *requester = zmq_socket(context, ZMQ_CLIENT);
 #else
-    void *requester = zmq_socket (context, ZMQ_REQ);
+    void *requester = zmq_socket (context, ZMQ_PUSH);
 #endif
 
     LOG(debug, getThreadName() + " zmq debug: requester = " +  to_string((uint64_t )requester));
 
     int timeout = ZMQ_TIMEOUT;
     int linger= 1000;
+    int hwm = ZMQ_HIGH_WATER_MARK;
 
     zmq_setsockopt(requester, ZMQ_SNDTIMEO, &timeout, sizeof(int));
     zmq_setsockopt(requester, ZMQ_RCVTIMEO, &timeout, sizeof(int));
     zmq_setsockopt(requester, ZMQ_LINGER, &linger, sizeof(int));
+    zmq_setsockopt(requester, ZMQ_SNDHWM, &hwm, sizeof(int));
 
 
     int result = zmq_connect(requester, ("tcp://" + *_ip + ":" + to_string(_basePort + BINARY_CONSENSUS)).c_str());
@@ -78,7 +80,7 @@ void *ZMQServerSocket::getReceiveSocket()  {
         receiveSocket = zmq_socket(context, ZMQ_SERVER);
 #else
 
-        receiveSocket = zmq_socket (context, ZMQ_REP);
+        receiveSocket = zmq_socket (context, ZMQ_PULL);
 
 
 #endif
@@ -87,10 +89,12 @@ void *ZMQServerSocket::getReceiveSocket()  {
 
         int timeout = ZMQ_TIMEOUT;
         int linger= 1000;
+        int hwm = ZMQ_HIGH_WATER_MARK;
 
         zmq_setsockopt(receiveSocket, ZMQ_RCVTIMEO, &timeout, sizeof(int));
         zmq_setsockopt(receiveSocket, ZMQ_SNDTIMEO, &timeout, sizeof(int));
         zmq_setsockopt(receiveSocket, ZMQ_LINGER, &linger, sizeof(int));
+        zmq_setsockopt(receiveSocket, ZMQ_RCVHWM, &hwm, sizeof(int));
 
 
         int rc = zmq_bind(receiveSocket, ("tcp://" + *bindIP + ":" + to_string(bindPort)).c_str());
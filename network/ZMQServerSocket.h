@@ -29,6 +29,8 @@
 
 static const int ZMQ_TIMEOUT = 1000;
 
+static const int ZMQ_HIGH_WATER_MARK = 100000;
+
 class ZMQServerSocket : public ServerSocket {
 
     mutex mainMutex;
@@ -75,6 +75,10 @@
 #include "../protocols/binconsensus/BinConsensusInstance.h"
 #include "../crypto/BLSPublicKey.h"
 #include "../crypto/BLSPrivateKey.h"
+#include "../datastructures/PendingTransaction.h"
+#include "../pendingqueue/PendingTransactionsAgent.h"
+#include "../threads/TransactionHashingPool.h"
+#include "../crypto/SHA3BatchHasher.h"
 
 #include "../exceptions/FatalError.h"
 
@@ -201,6 +205,8 @@ void ConsensusEngine::parseConfigsAndCreateAllNodes(const fs_path &dirname) {
 
     LOG(info, "INFO:Parsed configs and created " + to_string(ConsensusEngine::nodesCount()) +
               " nodes");
+
+    LOG(info, "Transaction hashing lanes:" + to_string(SHA3BatchHasher::getLanes()));
 }
 
 void ConsensusEngine::startAll() {
@@ -337,6 +343,96 @@ ConsensusExtFace *ConsensusEngine::getExtFace() const {
 }
 
 
+uint64_t ConsensusEngine::submitTransactions(ConsensusExtFace::transactions_vector &_transactions) {
+    vector<push_status> statuses;
+    return submitTransactions(_transactions, statuses);
+}
+
+
+uint64_t ConsensusEngine::submitTransactions(ConsensusExtFace::transactions_vector &_transactions,
+                                             vector<push_status> &_statuses) {
+
+    _statuses.assign(_transactions.size(), PUSH_QUEUE_FULL);
+
+    if (_transactions.empty() || nodes.empty())
+        return 0;
+
+    // free slots only bound the hashing work, tryPushTransaction decides what is taken
+    uint64_t limit = _transactions.size();
+
+    for (auto &&it : nodes) {
+        limit = min(limit, it.second->getSchain()->getPendingTransactionsAgent()->getFreeSlots());
+    }
+
+    limit = max(limit, (uint64_t) 1);
+
+    bool prioritize = extFace && nodes.begin()->second->getMempoolPolicy() == MEMPOOL_POLICY_PRIORITY;
+
+    vector<uint64_t> priorities;
+
+    vector<ptr<Transaction>> transactions;
+    transactions.reserve(limit);
+
+    for (uint64_t i = 0; i < limit; i++) {
+        if (prioritize) {
+            priorities.push_back(extFace->getTransactionPriority(_transactions[i]));
+        }
+        // the buffer is moved, each transaction owns exactly its own bytes
+        transactions.push_back(make_shared<PendingTransaction>(
+                make_shared<vector<uint8_t>>(std::move(_transactions[i]))));
+    }
+
+    // the producer thread takes part in hashing, so the transactions enter the mempool hashed
+    TransactionHashingPool::hashTransactions(transactions);
+
+    uint64_t count = 0;
+
+    // set when a node kept the transaction although another node was full
+    bool partiallyAccepted = false;
+
+    for (; count < limit; count++) {
+
+        auto status = PUSH_ACCEPTED;
+
+        bool accepted = false;
+
+        // with several nodes in one process a full queue wins, otherwise the first failure is reported
+        for (auto &&it : nodes) {
+            auto nodeStatus = it.second->getSchain()->getPendingTransactionsAgent()->tryPushTransaction(
+                    transactions[count], prioritize ? priorities[count] : 0);
+            if (status == PUSH_ACCEPTED || nodeStatus == PUSH_QUEUE_FULL)
+                status = nodeStatus;
+            accepted = accepted || nodeStatus == PUSH_ACCEPTED;
+        }
+
+        if (status == PUSH_QUEUE_FULL) {
+            partiallyAccepted = accepted;
+            break;
+        }
+
+        _statuses[count] = status;
+    }
+
+    // whatever did not fit goes back to the host, a transaction some node holds keeps its data
+    for (auto i = count; i < limit; i++) {
+        if (i == count && partiallyAccepted) {
+            _transactions[i] = *transactions[i]->getData();
+        } else {
+            _transactions[i] = std::move(*transactions[i]->getData());
+        }
+    }
+
+    _transactions.erase(_transactions.begin(), _transactions.begin() + count);
+
+    // _transactions is final, the host may submit again from the watermark callback
+    for (auto &&it : nodes) {
+        it.second->getSchain()->getPendingTransactionsAgent()->notifyPendingQueueWatermark();
+    }
+
+    return count;
+}
+
+
 void ConsensusEngine::exitGracefully() {
 
     for (auto const it : nodes) {
@@ -45,10 +45,33 @@ class ConsensusExtFace {
 public:
     typedef std::vector< std::vector< uint8_t > > transactions_vector;
 
-    // Returns hashes and bytes of new transactions; blocks if there are no txns
-    virtual transactions_vector pendingTransactions( size_t _limit ) = 0;
+    // Returns hashes and bytes of new transactions; blocks if there are no txns.
+    // Not called if the host pushes transactions through ConsensusEngine::submitTransactions
+    virtual transactions_vector pendingTransactions( size_t /*_limit*/ ) {
+        return transactions_vector();
+    }
+    // Return true to push transactions through ConsensusEngine::submitTransactions instead of being polled
+    virtual bool usesPushIngestion() const {
+        return false;
+    }
     // Creates new block with specified transactions AND removes them from the queue
     virtual void createBlock(const transactions_vector &_approvedTransactions, uint64_t _timeStamp, uint64_t _blockID) = 0;
+    // Same as above, with the millisecond part of the block time stamp. Override to get sub-second time stamps
+    virtual void createBlock(const transactions_vector &_approvedTransactions, uint64_t _timeStamp,
+                             uint32_t /*_timeStampMs*/, uint64_t _blockID) {
+        createBlock(_approvedTransactions, _timeStamp, _blockID);
+    }
+    // Called with true when the consensus pending queue fills up, and with false once it has drained
+    // below the low watermark. Transactions are not pulled through pendingTransactions() while it is full
+    virtual void pendingQueueWatermark(bool /*_full*/) {}
+    // Status of each transaction pulled through pendingTransactions(). PUSH_REJECTED means a duplicate or
+    // an already committed transaction, the host can drop it from its queue
+    virtual void transactionsPushed(const transactions_vector& /*_transactions*/,
+                                    const std::vector< push_status >& /*_statuses*/) {}
+    // Proposal priority of a pending transaction, higher goes first. Used with the "priority" mempool policy
+    virtual uint64_t getTransactionPriority(const std::vector< uint8_t >& /*_transaction*/) {
+        return 0;
+    }
     virtual ~ConsensusExtFace() = default;
 
     virtual void terminateApplication() {};
@@ -97,6 +120,21 @@ public:
 
     ConsensusExtFace* getExtFace() const;
 
+    /**
+     * Push ingestion. Never blocks. Takes the leading transactions until the pending queue is full,
+     * removes them from _transactions and returns their number. Duplicate and committed transactions
+     * are taken and dropped. Buffers are moved, not copied, and hashed on the calling thread and the
+     * hashing pool. Whatever is left should be submitted again after ConsensusExtFace::pendingQueueWatermark(false)
+     */
+    uint64_t submitTransactions(ConsensusExtFace::transactions_vector &_transactions);
+
+    /**
+     * Same as above, _statuses gets the status of every submitted transaction in submission order.
+     * PUSH_QUEUE_FULL marks the ones left in _transactions
+     */
+    uint64_t submitTransactions(ConsensusExtFace::transactions_vector &_transactions,
+                                std::vector<push_status> &_statuses);
+
 
     void startAll() override;
 
@@ -88,6 +88,8 @@
 #include "ConsensusInterface.h"
 #include "Node.h"
 #include "../exceptions/ParsingException.h"
+#include "../db/LevelDB.h"
+#include "../db/BlockLog.h"
 
 using namespace std;
 
@@ -119,6 +121,12 @@ void Node::initLevelDBs() {
     committedTransactionsDB = make_shared<LevelDB>(committedTransactionsDBFilename);
     signaturesDB = make_shared<LevelDB>(signaturesDBFilename);
 
+    blocksDB->migrateBlockKeys();
+
+    blockLog = make_shared<BlockLog>(dataDir + "/blocks_" + to_string(nodeID) + ".log");
+
+    committedFilterSnapshotPath = dataDir + "/transactions_" + to_string(nodeID) + ".snapshot";
+
 }
 
 void Node::initLogging() {
@@ -156,8 +164,40 @@ void Node::initParamsFromConfig() {
 
     minBlockIntervalMs = getParamUint64("minBlockIntervalMs", MIN_BLOCK_INTERVAL_MS);
 
+    proposalBatchSize = max(getParamUint64("proposalBatchSize", PROPOSAL_BATCH_SIZE), (uint64_t) 1);
+
+    proposalLatencyMs = getParamUint64("proposalLatencyMs", PROPOSAL_LATENCY_MS);
+
     committedBlockStorageSize = getParamUint64("committedBlockStorageSize", COMMITTED_BLOCK_STORAGE_SIZE);
 
+    consensusThreads = getParamUint64("consensusThreads", (uint64_t) NUM_SCHAIN_THREADS);
+
+    consensusBatchWindowUs = getParamUint64("consensusBatchWindowUs", CONSENSUS_BATCH_WINDOW_US);
+
+    consensusFrames = getParamBool("consensusFrames", CONSENSUS_FRAMES);
+
+    catchupChunkBlocks = getParamUint64("catchupChunkBlocks", CATCHUP_CHUNK_BLOCKS);
+
+    catchupChunkBytes = getParamUint64("catchupChunkBytes", CATCHUP_CHUNK_BYTES);
+
+    socketSendBufferSize = getParamUint64("socketSendBufferSize", SOCKET_SEND_BUFFER_SIZE);
+
+    socketReceiveBufferSize = getParamUint64("socketReceiveBufferSize", SOCKET_RECEIVE_BUFFER_SIZE);
+
+    maxPendingTransactions = max(getParamUint64("maxPendingTransactions", MAX_PENDING_TRANSACTIONS), (uint64_t) 1);
+
+    maxPendingTransactionBytes = getParamUint64("maxPendingTransactionBytes", MAX_PENDING_TRANSACTION_BYTES);
+
+    auto mempoolPolicyName = getParamString("mempoolPolicy", MEMPOOL_POLICY);
+
+    if (mempoolPolicyName == "fifo") {
+        mempoolPolicy = MEMPOOL_POLICY_FIFO;
+    } else if (mempoolPolicyName == "priority") {
+        mempoolPolicy = MEMPOOL_POLICY_PRIORITY;
+    } else {
+        BOOST_THROW_EXCEPTION(ParsingException("Unknown mempoolPolicy:" + mempoolPolicyName, __CLASS_NAME__));
+    }
+
     name = make_shared<string>(cfg.at("nodeName").get<string>());
 
     bindIP = make_shared<string>(cfg.at("bindIP").get<string>());
@@ -192,6 +232,22 @@ int64_t Node::getParamInt64(const string &paramName, uint64_t paramDefault) {
     }
 }
 
+string Node::getParamString(const string &paramName, const string &paramDefault) {
+    if (cfg.find(paramName) != cfg.end()) {
+        return cfg.at(paramName).get<string>();
+    } else {
+        return paramDefault;
+    }
+}
+
+bool Node::getParamBool(const string &paramName, bool paramDefault) {
+    if (cfg.find(paramName) != cfg.end()) {
+        return cfg.at(paramName).get<bool>();
+    } else {
+        return paramDefault;
+    }
+}
+
 
 Node::~Node() {
 
@@ -204,6 +260,7 @@ Node::~Node() {
 }
 
 void Node::cleanLevelDBs() {
+    blockLog = nullptr;
     blocksDB = nullptr;
     committedTransactionsDB = nullptr;
     signaturesDB = nullptr;
@@ -404,6 +461,8 @@ void Node::closeAllSocketsAndNotifyAllAgentsAndThreads() {
         agent->notifyAllConditionVariables();
     }
 
+    getSchain()->notifyAllConditionVariables();
+
     if (sockets->blockProposalSocket)
         sockets->blockProposalSocket->touch();
 
@@ -483,6 +542,15 @@ ptr<LevelDB> Node::getBlocksDB() {
     return blocksDB;
 }
 
+ptr<BlockLog> Node::getBlockLog() {
+    assert(blockLog);
+    return blockLog;
+}
+
+const string &Node::getCommittedFilterSnapshotPath() const {
+    return committedFilterSnapshotPath;
+}
+
 ptr<LevelDB> Node::getCommittedTransactionsDB() const {
     assert(committedTransactionsDB);
     return committedTransactionsDB;
@@ -545,10 +613,58 @@ uint64_t Node::getMinBlockIntervalMs() const {
     return minBlockIntervalMs;
 }
 
+uint64_t Node::getProposalBatchSize() const {
+    return proposalBatchSize;
+}
+
+uint64_t Node::getProposalLatencyMs() const {
+    return proposalLatencyMs;
+}
+
 uint64_t Node::getCommittedBlockStorageSize() const {
     return committedBlockStorageSize;
 }
 
+uint64_t Node::getConsensusThreads() const {
+    return consensusThreads;
+}
+
+uint64_t Node::getConsensusBatchWindowUs() const {
+    return consensusBatchWindowUs;
+}
+
+bool Node::isConsensusFrames() const {
+    return consensusFrames;
+}
+
+uint64_t Node::getCatchupChunkBlocks() const {
+    return catchupChunkBlocks;
+}
+
+uint64_t Node::getCatchupChunkBytes() const {
+    return catchupChunkBytes;
+}
+
+uint64_t Node::getSocketSendBufferSize() const {
+    return socketSendBufferSize;
+}
+
+uint64_t Node::getSocketReceiveBufferSize() const {
+    return socketReceiveBufferSize;
+}
+
+mempool_policy Node::getMempoolPolicy() const {
+    return mempoolPolicy;
+}
+
+uint64_t Node::getMaxPendingTransactions() const {
+    return maxPendingTransactions;
+}
+
+uint64_t Node::getMaxPendingTransactionBytes() const {
+    return maxPendingTransactionBytes;
+}
+
 uint64_t Node::getCommittedTransactionHistoryLimit() const {
     return committedTransactionsHistory;
 }
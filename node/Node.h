@@ -41,6 +41,7 @@ class SHAHash;
 class BLSPublicKey;
 class BLSPrivateKey;
 class LevelDB;
+class BlockLog;
 
 namespace leveldb{
     class DB;
@@ -117,6 +118,10 @@ class Node {
 
     ptr<LevelDB> blocksDB = nullptr;
 
+    ptr<BlockLog> blockLog = nullptr;
+
+    string committedFilterSnapshotPath;
+
     ptr<LevelDB> committedTransactionsDB = nullptr;
 
 
@@ -140,8 +145,32 @@ class Node {
 
     uint64_t minBlockIntervalMs;
 
+    uint64_t proposalBatchSize;
+
+    uint64_t proposalLatencyMs;
+
     uint64_t committedBlockStorageSize;
 
+    uint64_t consensusThreads;
+
+    uint64_t consensusBatchWindowUs;
+
+    bool consensusFrames;
+
+    uint64_t catchupChunkBlocks;
+
+    uint64_t catchupChunkBytes;
+
+    uint64_t socketSendBufferSize;
+
+    uint64_t socketReceiveBufferSize;
+
+    mempool_policy mempoolPolicy;
+
+    uint64_t maxPendingTransactions;
+
+    uint64_t maxPendingTransactionBytes;
+
 
     bool isBLSEnabled = false;
 public:
@@ -163,6 +192,10 @@ public:
 
     ptr<LevelDB> getBlocksDB();
 
+    ptr<BlockLog> getBlockLog();
+
+    const string &getCommittedFilterSnapshotPath() const;
+
 
     ptr<LevelDB> getCommittedTransactionsDB() const;
 
@@ -257,10 +290,34 @@ public:
 
     uint64_t getMinBlockIntervalMs() const;
 
+    uint64_t getProposalBatchSize() const;
+
+    uint64_t getProposalLatencyMs() const;
+
 
 
     uint64_t getCommittedBlockStorageSize() const;
 
+    uint64_t getConsensusThreads() const;
+
+    uint64_t getConsensusBatchWindowUs() const;
+
+    bool isConsensusFrames() const;
+
+    uint64_t getCatchupChunkBlocks() const;
+
+    uint64_t getCatchupChunkBytes() const;
+
+    uint64_t getSocketSendBufferSize() const;
+
+    uint64_t getSocketReceiveBufferSize() const;
+
+    mempool_policy getMempoolPolicy() const;
+
+    uint64_t getMaxPendingTransactions() const;
+
+    uint64_t getMaxPendingTransactionBytes() const;
+
 
     uint64_t getWaitAfterNetworkErrorMs();
 
@@ -269,6 +326,10 @@ public:
 
     int64_t getParamInt64(const string &paramName, uint64_t paramDefault);
 
+    string getParamString(const string &paramName, const string &paramDefault);
+
+    bool getParamBool(const string &paramName, bool paramDefault);
+
     void initParamsFromConfig();
 
     void initLogging();
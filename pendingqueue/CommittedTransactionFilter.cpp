@@ -0,0 +1,314 @@
+/*
+    Copyright (C) 2019 SKALE Labs
+
+    This file is part of skale-consensus.
+
+    skale-consensus is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    skale-consensus is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with skale-consensus.  If not, see <http://www.gnu.org/licenses/>.
+
+    @file CommittedTransactionFilter.cpp
+    @author Stan Kladko
+    @date 2019
+*/
+
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../SkaleConfig.h"
+#include "../Log.h"
+#include "../exceptions/FatalError.h"
+
+#include "CommittedTransactionFilter.h"
+
+
+static_assert(PARTIAL_SHA_HASH_LEN == sizeof(uint64_t), "Partial hash must fit into uint64");
+
+static constexpr uint64_t COMMITTED_FILTER_SNAPSHOT_MAGIC = 0x534B434F4D464C54;
+
+static constexpr uint64_t COMMITTED_FILTER_SNAPSHOT_VERSION = 1;
+
+
+CommittedTransactionFilter::CommittedTransactionFilter(uint64_t _capacity) : capacity(_capacity) {
+
+    ASSERT(capacity > 0);
+
+    // keep the load factor below 3/4
+    uint64_t tableSize = 16;
+    while (tableSize * 3 < capacity * 4) {
+        tableSize *= 2;
+    }
+
+    mask = tableSize - 1;
+
+    table.resize(tableSize, 0);
+    ring.resize(capacity, 0);
+}
+
+
+uint64_t CommittedTransactionFilter::toKey(const partial_sha_hash &_hash) {
+    uint64_t key;
+    memcpy(&key, _hash.data(), sizeof(key));
+    return key;
+}
+
+
+uint64_t CommittedTransactionFilter::slotOf(uint64_t _key) const {
+    return hash(_key) & mask;
+}
+
+
+bool CommittedTransactionFilter::contains(uint64_t _key) const {
+
+    if (_key == 0)
+        return containsZeroKey;
+
+    for (auto i = slotOf(_key);; i = (i + 1) & mask) {
+        if (table[i] == _key)
+            return true;
+        if (table[i] == 0)
+            return false;
+    }
+}
+
+
+bool CommittedTransactionFilter::contains(const partial_sha_hash &_hash) const {
+    return contains(toKey(_hash));
+}
+
+
+void CommittedTransactionFilter::insert(uint64_t _key) {
+
+    if (_key == 0) {
+        containsZeroKey = true;
+        return;
+    }
+
+    auto i = slotOf(_key);
+    while (table[i] != 0) {
+        i = (i + 1) & mask;
+    }
+    table[i] = _key;
+}
+
+
+void CommittedTransactionFilter::remove(uint64_t _key) {
+
+    if (_key == 0) {
+        containsZeroKey = false;
+        return;
+    }
+
+    auto i = slotOf(_key);
+    while (table[i] != _key) {
+        ASSERT(table[i] != 0);
+        i = (i + 1) & mask;
+    }
+
+    i = SeededHash::shiftBack(i, mask, [this](uint64_t _j) { return table[_j] == 0; },
+                              [this](uint64_t _j) { return slotOf(table[_j]); },
+                              [this](uint64_t _to, uint64_t _from) { table[_to] = table[_from]; });
+
+    table[i] = 0;
+}
+
+
+void CommittedTransactionFilter::expireFirst() {
+
+    ASSERT(size > 0);
+
+    remove(ring[ringStart]);
+    ringStart = (ringStart + 1) % capacity;
+    size--;
+}
+
+
+void CommittedTransactionFilter::expireOldestBlock() {
+
+    ASSERT(!blockSizes.empty());
+
+    for (uint64_t n = 0; n < blockSizes.front(); n++) {
+        expireFirst();
+    }
+
+    blockSizes.pop_front();
+}
+
+
+void CommittedTransactionFilter::addBlock(const vector<uint64_t> &_keys) {
+    addBlock(_keys.data(), _keys.size());
+}
+
+
+void CommittedTransactionFilter::addBlock(const uint64_t *_keys, uint64_t _count) {
+
+    while (!blockSizes.empty() && size + _count > capacity) {
+        expireOldestBlock();
+    }
+
+    uint64_t added = 0;
+
+    for (uint64_t i = 0; i < _count; i++) {
+
+        auto key = _keys[i];
+
+        // a duplicate stays in the generation that committed it first
+        if (contains(key))
+            continue;
+
+        if (size == capacity) {
+            if (!blockSizes.empty()) {
+                expireOldestBlock();
+            } else {
+                // a single block larger than the capacity expires its own oldest keys
+                expireFirst();
+                added--;
+            }
+        }
+
+        insert(key);
+        ring[(ringStart + size) % capacity] = key;
+        size++;
+        added++;
+    }
+
+    if (added > 0) {
+        blockSizes.push_back(added);
+    }
+}
+
+
+uint64_t CommittedTransactionFilter::checksum(const uint64_t *_data, uint64_t _count) {
+
+    // FNV-1a over words
+    uint64_t hash = 0xcbf29ce484222325;
+
+    for (uint64_t i = 0; i < _count; i++) {
+        hash ^= _data[i];
+        hash *= 0x100000001b3;
+    }
+
+    return hash;
+}
+
+
+ptr<string> CommittedTransactionFilter::createSnapshot(uint64_t _blockID, uint64_t _counter) const {
+
+    SnapshotHeader header;
+    header.magic = COMMITTED_FILTER_SNAPSHOT_MAGIC;
+    header.version = COMMITTED_FILTER_SNAPSHOT_VERSION;
+    header.blockID = _blockID;
+    header.counter = _counter;
+    header.blockCount = blockSizes.size();
+    header.keyCount = size;
+
+    auto snapshot = make_shared<string>(sizeof(header) + (header.blockCount + header.keyCount) * sizeof(uint64_t),
+                                        '\0');
+
+    auto payload = (uint64_t *) (&(*snapshot)[0] + sizeof(header));
+
+    auto position = payload;
+
+    for (auto blockSize : blockSizes) {
+        *position++ = blockSize;
+    }
+
+    // keys in commit order, unwrapping the ring
+    auto firstPart = min(size, capacity - ringStart);
+    memcpy(position, ring.data() + ringStart, firstPart * sizeof(uint64_t));
+    memcpy(position + firstPart, ring.data(), (size - firstPart) * sizeof(uint64_t));
+
+    header.checksum = checksum(payload, header.blockCount + header.keyCount);
+
+    memcpy(&(*snapshot)[0], &header, sizeof(header));
+
+    return snapshot;
+}
+
+
+bool CommittedTransactionFilter::loadSnapshot(const string &_path, uint64_t &_blockID, uint64_t &_counter) {
+
+    int fd = open(_path.c_str(), O_RDONLY);
+
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || (uint64_t) st.st_size < sizeof(SnapshotHeader)) {
+        close(fd);
+        return false;
+    }
+
+    uint64_t fileSize = st.st_size;
+
+    auto data = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    close(fd);
+
+    if (data == MAP_FAILED)
+        return false;
+
+    madvise(data, fileSize, MADV_SEQUENTIAL);
+
+    SnapshotHeader header;
+    memcpy(&header, data, sizeof(header));
+
+    auto payload = (const uint64_t *) ((const uint8_t *) data + sizeof(header));
+
+    bool valid = header.magic == COMMITTED_FILTER_SNAPSHOT_MAGIC &&
+                 header.version == COMMITTED_FILTER_SNAPSHOT_VERSION &&
+                 header.blockCount <= header.keyCount &&
+                 fileSize == sizeof(header) + (header.blockCount + header.keyCount) * sizeof(uint64_t) &&
+                 checksum(payload, header.blockCount + header.keyCount) == header.checksum;
+
+    if (valid) {
+        uint64_t total = 0;
+        for (uint64_t i = 0; i < header.blockCount; i++) {
+            total += payload[i];
+        }
+        valid = total == header.keyCount;
+    }
+
+    if (valid) {
+        auto keys = payload + header.blockCount;
+        for (uint64_t i = 0; i < header.blockCount; i++) {
+            addBlock(keys, payload[i]);
+            keys += payload[i];
+        }
+        _blockID = header.blockID;
+        _counter = header.counter;
+    } else {
+        LOG(err, "Ignoring invalid committed transactions snapshot " + _path);
+    }
+
+    munmap(data, fileSize);
+
+    return valid;
+}
+
+
+uint64_t CommittedTransactionFilter::getSize() const {
+    return size;
+}
+
+
+uint64_t CommittedTransactionFilter::getCapacity() const {
+    return capacity;
+}
+
+
+uint64_t CommittedTransactionFilter::getMemorySize() const {
+    return (table.size() + ring.size() + blockSizes.size()) * sizeof(uint64_t);
+}
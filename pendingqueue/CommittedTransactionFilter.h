@@ -0,0 +1,118 @@
+/*
+    Copyright (C) 2019 SKALE Labs
+
+    This file is part of skale-consensus.
+
+    skale-consensus is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    skale-consensus is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with skale-consensus.  If not, see <http://www.gnu.org/licenses/>.
+
+    @file CommittedTransactionFilter.h
+    @author Stan Kladko
+    @date 2019
+*/
+
+
+#pragma once
+
+
+#include "SeededHash.h"
+
+
+/**
+ * Exact set of the most recently committed partial transaction hashes with a fixed memory budget.
+ *
+ * Hashes are stored as uint64 keys in a preallocated open addressing table. A ring buffer keeps
+ * the keys in commit order, split into per-block generations. When the capacity is reached,
+ * whole blocks are expired from the oldest end of the ring. Depending on the table load, 19 to 30 bytes are used per hash.
+ * Not thread safe, callers synchronize.
+ *
+ * A snapshot is a flat file with a header, the block sizes and the keys in commit order.
+ * Loading one maps the file and rebuilds the table without touching the database.
+ */
+class CommittedTransactionFilter {
+
+    struct SnapshotHeader {
+        uint64_t magic;
+        uint64_t version;
+        uint64_t blockID;
+        uint64_t counter;
+        uint64_t blockCount;
+        uint64_t keyCount;
+        uint64_t checksum;
+    };
+
+    uint64_t capacity;
+
+    uint64_t mask;
+
+    SeededHash hash;
+
+    // 0 marks an empty slot, a zero key is tracked separately
+    vector<uint64_t> table;
+
+    bool containsZeroKey = false;
+
+    vector<uint64_t> ring;
+
+    uint64_t ringStart = 0;
+
+    uint64_t size = 0;
+
+    // number of keys of each completed block in the ring, oldest first
+    deque<uint64_t> blockSizes;
+
+    uint64_t slotOf(uint64_t _key) const;
+
+    void insert(uint64_t _key);
+
+    void remove(uint64_t _key);
+
+    void expireFirst();
+
+    void expireOldestBlock();
+
+    static uint64_t checksum(const uint64_t *_data, uint64_t _count);
+
+public:
+
+    explicit CommittedTransactionFilter(uint64_t _capacity);
+
+    static uint64_t toKey(const partial_sha_hash &_hash);
+
+    bool contains(uint64_t _key) const;
+
+    bool contains(const partial_sha_hash &_hash) const;
+
+    /**
+     * Adds the hashes of a committed block as one generation, expiring the oldest blocks if needed
+     */
+    void addBlock(const vector<uint64_t> &_keys);
+
+    void addBlock(const uint64_t *_keys, uint64_t _count);
+
+    /**
+     * Serializes the filter state as of _blockID, to be written to disk by the caller
+     */
+    ptr<string> createSnapshot(uint64_t _blockID, uint64_t _counter) const;
+
+    /**
+     * Adds the blocks of a snapshot file. Returns false if the file is missing or invalid
+     */
+    bool loadSnapshot(const string &_path, uint64_t &_blockID, uint64_t &_counter);
+
+    uint64_t getSize() const;
+
+    uint64_t getCapacity() const;
+
+    uint64_t getMemorySize() const;
+};
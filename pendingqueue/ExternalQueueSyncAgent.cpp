@@ -62,10 +62,21 @@ void ExternalQueueSyncAgent::workerThreadMessagePushLoop( ExternalQueueSyncAgent
         while ( true ) {
             ConsensusExtFace::transactions_vector transactions;
 
+            auto pendingAgent = agent->getSubChain()->getPendingTransactionsAgent();
+
             do {
                 agent->getSubChain()->getNode()->exitCheck();
+
+                // pull only what fits, the rest stays in the external queue until a block commits
+                auto freeSlots = pendingAgent->getFreeSlots();
+
+                if ( freeSlots == 0 ) {
+                    pendingAgent->waitForSpace( PENDING_QUEUE_WAIT_MS );
+                    continue;
+                }
+
                 transactions = agent->extFace->pendingTransactions(
-                    agent->getNode()->getMaxTransactionsPerBlock() );
+                    min( agent->getNode()->getMaxTransactionsPerBlock(), freeSlots ) );
             } while ( transactions.size() == 0 );
 
             LOG( debug,
@@ -73,13 +84,28 @@ void ExternalQueueSyncAgent::workerThreadMessagePushLoop( ExternalQueueSyncAgent
 
             auto txs = make_shared< vector< ptr< Transaction > > >();
 
+            vector< uint64_t > priorities;
+
+            bool prioritize = agent->getNode()->getMempoolPolicy() == MEMPOOL_POLICY_PRIORITY;
+
             for ( const auto& t : transactions ) {
+                if ( prioritize ) {
+                    priorities.push_back( agent->extFace->getTransactionPriority( t ) );
+                }
                 auto data = make_shared< vector< uint8_t > >( t );
                 auto transaction = make_shared< PendingTransaction >( data );
                 txs->push_back( transaction );
             }
 
-            agent->getSubChain()->getPendingTransactionsAgent()->pushTransactions( txs );
+            vector< push_status > statuses;
+
+            if ( prioritize ) {
+                statuses = pendingAgent->pushTransactions( txs, priorities );
+            } else {
+                statuses = pendingAgent->pushTransactions( txs );
+            }
+
+            agent->extFace->transactionsPushed( transactions, statuses );
         };
     } catch ( ExitRequestedException& ) {
         return;
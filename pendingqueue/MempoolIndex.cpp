@@ -0,0 +1,74 @@
+/*
+    Copyright (C) 2019 SKALE Labs
+
+    This file is part of skale-consensus.
+
+    skale-consensus is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    skale-consensus is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with skale-consensus.  If not, see <http://www.gnu.org/licenses/>.
+
+    @file MempoolIndex.cpp
+    @author Stan Kladko
+    @date 2019
+*/
+
+
+#include "../SkaleConfig.h"
+#include "../Log.h"
+#include "../exceptions/FatalError.h"
+#include "../datastructures/Transaction.h"
+
+#include "MempoolIndex.h"
+
+
+MempoolIndex::MempoolIndex(mempool_policy _policy) : policy(_policy) {}
+
+
+bool MempoolIndex::add(uint64_t _key, uint64_t _priority, uint64_t _sequence,
+                       const ptr<Transaction> &_transaction) {
+
+    ASSERT(_transaction);
+
+    if (positions.count(_key) > 0)
+        return false;
+
+    order_key position(policy == MEMPOOL_POLICY_PRIORITY ? UINT64_MAX - _priority : 0, _sequence);
+
+    ordered.emplace(position, make_pair(_key, _transaction));
+    positions.emplace(_key, position);
+
+    return true;
+}
+
+
+bool MempoolIndex::remove(uint64_t _key) {
+
+    auto it = positions.find(_key);
+
+    if (it == positions.end())
+        return false;
+
+    ordered.erase(it->second);
+    positions.erase(it);
+
+    return true;
+}
+
+
+uint64_t MempoolIndex::getSize() const {
+    return positions.size();
+}
+
+
+mempool_policy MempoolIndex::getPolicy() const {
+    return policy;
+}
@@ -0,0 +1,91 @@
+/*
+    Copyright (C) 2019 SKALE Labs
+
+    This file is part of skale-consensus.
+
+    skale-consensus is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    skale-consensus is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with skale-consensus.  If not, see <http://www.gnu.org/licenses/>.
+
+    @file MempoolIndex.h
+    @author Stan Kladko
+    @date 2019
+*/
+
+
+#pragma once
+
+
+#include "SeededHash.h"
+
+
+class Transaction;
+
+
+/**
+ * Pending transactions in proposal order.
+ *
+ * FIFO orders by arrival. PRIORITY orders by the priority supplied through ConsensusExtFace,
+ * highest first, and by arrival within the same priority. Selecting k transactions walks
+ * the first k entries. Committed transactions are removed one by one as blocks commit.
+ * Not thread safe, callers synchronize.
+ */
+class MempoolIndex {
+
+    // (inverted priority, arrival sequence)
+    typedef pair<uint64_t, uint64_t> order_key;
+
+    mempool_policy policy;
+
+    map<order_key, pair<uint64_t, ptr<Transaction>>> ordered;
+
+    unordered_map<uint64_t, order_key, SeededHash> positions;
+
+public:
+
+    explicit MempoolIndex(mempool_policy _policy);
+
+    /**
+     * _sequence is the arrival order, assigned when the transaction was pushed.
+     * Returns false if the transaction is already indexed
+     */
+    bool add(uint64_t _key, uint64_t _priority, uint64_t _sequence, const ptr<Transaction> &_transaction);
+
+    bool remove(uint64_t _key);
+
+    /**
+     * Appends up to _max transactions in policy order. Entries for which _isStale returns true
+     * are skipped, removed from the index and their keys appended to _staleKeys
+     */
+    template<typename StalePredicate>
+    void select(uint64_t _max, vector<ptr<Transaction>> &_result, StalePredicate &&_isStale,
+                vector<uint64_t> &_staleKeys) {
+
+        auto it = ordered.begin();
+
+        while (it != ordered.end() && _result.size() < _max) {
+            auto key = it->second.first;
+            if (_isStale(key)) {
+                _staleKeys.push_back(key);
+                positions.erase(key);
+                it = ordered.erase(it);
+            } else {
+                _result.push_back(it->second.second);
+                ++it;
+            }
+        }
+    }
+
+    uint64_t getSize() const;
+
+    mempool_policy getPolicy() const;
+};
@@ -32,6 +32,7 @@
 #include "../datastructures/BlockProposal.h"
 #include "../datastructures/MyBlockProposal.h"
 #include "../node/Node.h"
+#include "../node/ConsensusEngine.h"
 #include "../datastructures/PartialHashesList.h"
 #include "../datastructures/Transaction.h"
 #include "../datastructures/TransactionList.h"
@@ -41,81 +42,350 @@
 #include "../db/LevelDB.h"
 
 
+#include "../db/StorageAgent.h"
+#include "../threads/TransactionHashingPool.h"
 #include "PendingTransactionsAgent.h"
 
 using namespace std;
 
 
 PendingTransactionsAgent::PendingTransactionsAgent( Schain& ref_sChain )
-    : Agent(ref_sChain, false) {
-
+    : Agent(ref_sChain, false), pendingTransactionsCount(0), pendingTransactionsBytes(0),
+      insertedTransactionsCount(0), pendingQueueFull(false),
+      arrivalSequence(0), knownTransactionsCount(0) {
 
     auto cfg = getSchain()->getNode()->getCfg();
 
+    committedTransactions = make_shared<CommittedTransactionFilter>(getNode()->getCommittedTransactionHistoryLimit());
+
+    mempoolIndex = make_shared<MempoolIndex>(getNode()->getMempoolPolicy());
+
+    migrateLegacyCommittedTransactions();
+
+    if (!loadCommittedTransactionsFromSnapshot()) {
+        loadCommittedTransactions();
+    }
+
+    lastSnapshotBlockID = lastCommittedBlockID;
+
+    LOG(info, "Loaded committed transactions:" + to_string(committedTransactions->getSize()));
+}
+
 
-    auto db = getSchain()->getNode()->getBlocksDB();
+string PendingTransactionsAgent::createCommittedTransactionsKey(uint64_t _blockID) {
+    string key(1, COMMITTED_TRANSACTIONS_KEY_PREFIX);
+    LevelDB::appendUint64BigEndian(key, _blockID);
+    return key;
+}
+
+
+class CommittedTransactionsCollector : public LevelDB::KeyValueVisitor {
+public:
+
+    uint64_t limit;
+
+    uint64_t count = 0;
 
-    static string count("COUNT");
+    uint64_t counter = 0;
 
-    auto value = db->readString(count);
+    uint64_t lastBlockID = 0;
 
-    if (value != nullptr) {
-        committedTransactionCounter = stoul(*value);
+    // newest block first
+    vector<vector<uint64_t>> blocks;
+
+    explicit CommittedTransactionsCollector(uint64_t _limit) : limit(_limit) {}
+
+    bool visitDBKeyValue(leveldb::Slice _key, leveldb::Slice _value) override {
+
+        if (_key.size() != sizeof(uint64_t) + 1 || _value.size() < sizeof(uint64_t) ||
+            (_value.size() - sizeof(uint64_t)) % PARTIAL_SHA_HASH_LEN != 0) {
+            LOG(err, "Skipping invalid committed transactions record");
+            return true;
+        }
+
+        auto data = (const uint8_t *) _value.data();
+
+        // the counter of the newest record is the current one
+        if (blocks.empty()) {
+            memcpy(&counter, data, sizeof(uint64_t));
+            lastBlockID = LevelDB::parseUint64BigEndian(_key.data() + 1);
+        }
+
+        auto hashCount = (_value.size() - sizeof(uint64_t)) / PARTIAL_SHA_HASH_LEN;
+
+        // keep the newest hashes of a record that crosses the limit
+        auto first = hashCount > limit - count ? hashCount - (limit - count) : 0;
+
+        blocks.emplace_back();
+        blocks.back().reserve(hashCount - first);
+
+        for (auto i = first; i < hashCount; i++) {
+            uint64_t key;
+            memcpy(&key, data + sizeof(uint64_t) + i * PARTIAL_SHA_HASH_LEN, sizeof(key));
+            blocks.back().push_back(key);
+        }
+
+        count += hashCount - first;
+
+        return count < limit;
     }
+};
+
+
+void PendingTransactionsAgent::loadCommittedTransactions() {
 
     auto cdb = getNode()->getCommittedTransactionsDB();
 
+    CommittedTransactionsCollector collector(getNode()->getCommittedTransactionHistoryLimit());
+
+    cdb->visitKeyValuesReverse(createCommittedTransactionsKey(0), createCommittedTransactionsKey(UINT64_MAX),
+                               &collector, UINT64_MAX);
+
+    for (auto block = collector.blocks.rbegin(); block != collector.blocks.rend(); block++) {
+        committedTransactions->addBlock(*block);
+    }
+
+    committedTransactionCounter = collector.counter;
+    lastCommittedBlockID = collector.lastBlockID;
+}
+
+
+class CommittedTransactionsReplayer : public LevelDB::KeyValueVisitor {
+public:
+
+    CommittedTransactionFilter &filter;
+
+    uint64_t &counter;
+
+    uint64_t &lastBlockID;
+
+    vector<uint64_t> keys;
+
+    CommittedTransactionsReplayer(CommittedTransactionFilter &_filter, uint64_t &_counter, uint64_t &_lastBlockID)
+        : filter(_filter), counter(_counter), lastBlockID(_lastBlockID) {}
+
+    bool visitDBKeyValue(leveldb::Slice _key, leveldb::Slice _value) override {
+
+        if (_key.size() != sizeof(uint64_t) + 1 || _value.size() < sizeof(uint64_t) ||
+            (_value.size() - sizeof(uint64_t)) % PARTIAL_SHA_HASH_LEN != 0) {
+            LOG(err, "Skipping invalid committed transactions record");
+            return true;
+        }
+
+        auto data = (const uint8_t *) _value.data();
+
+        memcpy(&counter, data, sizeof(uint64_t));
+        lastBlockID = LevelDB::parseUint64BigEndian(_key.data() + 1);
+
+        keys.resize((_value.size() - sizeof(uint64_t)) / PARTIAL_SHA_HASH_LEN);
+        memcpy(keys.data(), data + sizeof(uint64_t), keys.size() * sizeof(uint64_t));
+
+        filter.addBlock(keys);
+
+        return true;
+    }
+};
+
+
+bool PendingTransactionsAgent::loadCommittedTransactionsFromSnapshot() {
 
-    cdb->visitKeys(this, getNode()->getCommittedTransactionHistoryLimit() - committedTransactionCounter);
+    uint64_t snapshotBlockID;
 
+    if (!committedTransactions->loadSnapshot(getNode()->getCommittedFilterSnapshotPath(), snapshotBlockID,
+                                             committedTransactionCounter))
+        return false;
+
+    lastCommittedBlockID = snapshotBlockID;
+
+    CommittedTransactionsReplayer replayer(*committedTransactions, committedTransactionCounter, lastCommittedBlockID);
+
+    auto replayed = getNode()->getCommittedTransactionsDB()->visitKeyValues(
+            createCommittedTransactionsKey(snapshotBlockID + 1), createCommittedTransactionsKey(UINT64_MAX),
+            &replayer, UINT64_MAX);
+
+    LOG(info, "Loaded committed transactions snapshot at block " + to_string(snapshotBlockID) +
+              ", replayed blocks:" + to_string(replayed));
+
+    return true;
 }
 
-void PendingTransactionsAgent::visitDBKey(leveldb::Slice _key) {
-    auto s = make_shared<partial_sha_hash>();
-    std::copy_n((uint8_t*)_key.data(), PARTIAL_SHA_HASH_LEN, s->begin());
-    addToCommitted(s);
-    committedTransactionCounter++;
+
+ptr<string> PendingTransactionsAgent::createCommittedFilterSnapshot(uint64_t &_blockID) {
+    lock_guard<recursive_mutex> lock(transactionsMutex);
+    _blockID = lastCommittedBlockID;
+    return committedTransactions->createSnapshot(lastCommittedBlockID, committedTransactionCounter);
 }
 
 
+class LegacyCommittedTransactionsCollector : public LevelDB::KeyValueVisitor {
+public:
+
+    vector<pair<uint64_t, string>> transactions;
+
+    vector<string> keys;
+
+    bool visitDBKeyValue(leveldb::Slice _key, leveldb::Slice _value) override {
+
+        if (_key.size() == PARTIAL_SHA_HASH_LEN && _value.size() == sizeof(uint64_t)) {
+            uint64_t counter;
+            memcpy(&counter, _value.data(), sizeof(counter));
+            transactions.emplace_back(counter, _key.ToString());
+            keys.push_back(_key.ToString());
+        } else if (_key.ToString() == "transactions") {
+            keys.push_back(_key.ToString());
+        }
+
+        return true;
+    }
+};
+
+
+void PendingTransactionsAgent::migrateLegacyCommittedTransactions() {
+
+    static string versionKey("VERSION:COMMITTED_TRANSACTIONS");
 
-void PendingTransactionsAgent::addToCommitted(ptr<partial_sha_hash> &s)  {
-    committedTransactions.insert(s);
-    committedTransactionsList.push_back(s);
+    auto cdb = getNode()->getCommittedTransactionsDB();
+
+    auto version = cdb->readString(versionKey);
+
+    if (version != nullptr && *version == to_string(COMMITTED_TRANSACTIONS_VERSION))
+        return;
+
+    LegacyCommittedTransactionsCollector collector;
+
+    cdb->visitKeyValues(string(), string(PARTIAL_SHA_HASH_LEN + sizeof(uint64_t), '\xff'), &collector, UINT64_MAX);
+
+    if (collector.keys.empty()) {
+        cdb->writeString(versionKey, to_string(COMMITTED_TRANSACTIONS_VERSION));
+        return;
+    }
+
+    sort(collector.transactions.begin(), collector.transactions.end());
+
+    auto limit = getNode()->getCommittedTransactionHistoryLimit();
+
+    auto first = collector.transactions.size() > limit ? collector.transactions.size() - limit : 0;
+
+    string record(sizeof(uint64_t), '\0');
+
+    uint64_t counter = collector.transactions.empty() ? 0 : collector.transactions.back().first + 1;
+
+    memcpy(&record[0], &counter, sizeof(counter));
+
+    for (auto i = first; i < collector.transactions.size(); i++) {
+        record.append(collector.transactions[i].second);
+    }
+
+    // everything committed before the upgrade goes into one record that sorts before all blocks
+    cdb->writeBatch({{createCommittedTransactionsKey(0), record},
+                     {versionKey, to_string(COMMITTED_TRANSACTIONS_VERSION)}}, collector.keys);
+
+    LOG(info, "Migrated committed transactions:" + to_string(collector.transactions.size() - first));
 }
 
 
+
 void PendingTransactionsAgent::cleanCommittedTransactionsFromQueue(ptr<BlockProposal> _committedBlockProposal) {
     lock_guard<recursive_mutex> lock(transactionsMutex);
     auto transactions = _committedBlockProposal->getTransactionList()->getItems();
+
+    auto blockID = (uint64_t) _committedBlockProposal->getBlockID();
+
+    // after a crash the stored records can be ahead of skaled, blocks committed again are already in the filter
+    bool recorded = blockID <= lastCommittedBlockID;
+
+    // one record per block: the counter after the block followed by the packed partial hashes
+    string record(sizeof(uint64_t), '\0');
+    record.reserve(sizeof(uint64_t) + transactions->size() * PARTIAL_SHA_HASH_LEN);
+
+    vector<uint64_t> keys;
+    keys.reserve(transactions->size());
+
+    vector<uint64_t> removedPending;
+
+    uint64_t removedBytes = 0;
+
     for (auto &&t : *transactions) {
-        ASSERT(!isCommitted(t->getPartialHash()));
-        pushCommittedTransaction(t);
-        pendingTransactions.erase(t->getPartialHash());
-        knownTransactions.erase(t->getPartialHash());
+        auto key = t->getPartialHashKey();
+        if (!recorded) {
+            ASSERT(!committedTransactions->contains(key));
+            keys.push_back(key);
+            record.append((const char *) t->getPartialHash()->data(), PARTIAL_SHA_HASH_LEN);
+        }
+
+        auto &shard = getShard(key);
+        lock_guard<mutex> shardLock(shard.shardMutex);
+        if (shard.pendingTransactions.erase(key)) {
+            insertedTransactionsCount--;
+            removedPending.push_back(key);
+            removedBytes += t->getData()->size();
+        }
+        if (shard.knownTransactions.erase(key))
+            knownTransactionsCount--;
     }
-}
 
+    if (!removedPending.empty()) {
+        {
+            lock_guard<mutex> indexLock(indexMutex);
+            for (auto key : removedPending) {
+                mempoolIndex->remove(key);
+            }
+        }
+        releasePending(removedPending.size(), removedBytes);
+    }
+
+    if (recorded) {
+        LOG(debug, "Committed transactions already recorded for block:" + to_string(blockID));
+        return;
+    }
+
+    {
+        lock_guard<shared_mutex> committedLock(committedMutex);
+        committedTransactions->addBlock(keys);
+    }
+
+    committedTransactionCounter += transactions->size();
+
+    memcpy(&record[0], &committedTransactionCounter, sizeof(committedTransactionCounter));
+
+    auto storageAgent = getSchain()->getStorageAgent();
 
+    lastCommittedBlockID = blockID;
 
-ptr<BlockProposal> PendingTransactionsAgent::buildBlockProposal(block_id _blockID, uint64_t _previousBlockTimeStamp) {
+    storageAgent->saveCommittedTransactions(createCommittedTransactionsKey(lastCommittedBlockID), std::move(record));
 
-    usleep(getNode()->getMinBlockIntervalMs() * 1000);
+    if (lastCommittedBlockID >= lastSnapshotBlockID + COMMITTED_FILTER_SNAPSHOT_INTERVAL_BLOCKS) {
+        storageAgent->saveCommittedFilterSnapshot(lastCommittedBlockID,
+                                                  committedTransactions->createSnapshot(lastCommittedBlockID,
+                                                                                        committedTransactionCounter));
+        lastSnapshotBlockID = lastCommittedBlockID;
+    }
+}
+
+
+
+ptr<BlockProposal> PendingTransactionsAgent::buildBlockProposal(block_id _blockID, uint64_t _previousBlockTimeStamp,
+                                                                uint32_t _previousBlockTimeStampMs) {
 
-    waitUntilPendingTransaction();
+    waitUntilPendingTransaction(Schain::getCurrentTimeMs());
 
     shared_ptr<vector<ptr<Transaction>>> transactions = createTransactionsListForProposal();
 
 
-    while ((uint64_t )Schain::getCurrentTimeSec() <= _previousBlockTimeStamp) {
-        usleep(1000);
+    auto previousBlockTimeMs = _previousBlockTimeStamp * 1000 + _previousBlockTimeStampMs;
+
+    uint64_t currentTimeMs;
+
+    // time stamps must grow, sleep once for the remaining difference instead of spinning
+    while ((currentTimeMs = Schain::getCurrentTimeMs()) <= previousBlockTimeMs) {
+        usleep((previousBlockTimeMs - currentTimeMs + 1) * 1000);
     }
 
 
     auto transactionList = make_shared<TransactionList>(transactions);
 
     auto myBlockProposal = make_shared<MyBlockProposal>(*sChain, _blockID, sChain->getSchainIndex(),
-            transactionList, Schain::getCurrentTimeSec());
+            transactionList, currentTimeMs / 1000, (uint32_t) (currentTimeMs % 1000));
     LOG(trace, "Created proposal, transactions:" + to_string(transactions->size()));
 ;
     transactionCounter += (uint64_t) myBlockProposal->createPartialHashesList()->getTransactionCount();
@@ -125,48 +395,132 @@ ptr<BlockProposal> PendingTransactionsAgent::buildBlockProposal(block_id _blockI
 shared_ptr<vector<ptr<Transaction>>> PendingTransactionsAgent::createTransactionsListForProposal() {
     auto transactions = make_shared<vector<ptr<Transaction>>>();
 
+    auto maxTransactions = getNode()->getMaxTransactionsPerBlock();
+
     {
         lock_guard<recursive_mutex> lock(transactionsMutex);
 
-        LOG(trace, "Out of wait, transactions:" + to_string(pendingTransactions.size()));
-
-        auto iterator = pendingTransactions.cbegin();
-        while (iterator != pendingTransactions.cend()) {
-            if (isCommitted(iterator->first)) {
-                iterator = pendingTransactions.erase(iterator);
-            } else {
+        LOG(trace, "Out of wait, transactions:" + to_string(pendingTransactionsCount));
 
+        // committed transactions are normally removed when their block commits, this only catches
+        // the ones pushed concurrently with the commit
+        vector<uint64_t> committed;
 
+        indexStagedTransactions();
 
-                ++iterator;;
+        {
+            lock_guard<mutex> indexLock(indexMutex);
+            transactions->reserve(min(maxTransactions, mempoolIndex->getSize()));
+            mempoolIndex->select(maxTransactions, *transactions, [this](uint64_t _key) {
+                return committedTransactions->contains(_key);
+            }, committed);
+        }
 
+        for (auto key : committed) {
+            auto &shard = getShard(key);
+            lock_guard<mutex> shardLock(shard.shardMutex);
+            auto transaction = shard.pendingTransactions.get(key);
+            if (transaction && shard.pendingTransactions.erase(key)) {
+                insertedTransactionsCount--;
+                releasePending(1, transaction->getData()->size());
             }
         }
-        uint64_t i = 0;
-        for (auto const &x : pendingTransactions) {
+    }
+    return transactions;
+}
+
+void PendingTransactionsAgent::waitUntilPendingTransaction(uint64_t _startTimeMs) {
+
+    auto node = getNode();
+
+    auto earliestMs = _startTimeMs + node->getMinBlockIntervalMs();
+    auto latencyDeadlineMs = earliestMs + node->getProposalLatencyMs();
+    auto emptyBlockDeadlineMs = earliestMs + node->getEmptyBlockIntervalMs();
+    auto batchSize = node->getProposalBatchSize();
+
+    unique_lock<mutex> lock(proposalMutex);
 
+    while (true) {
 
+        node->exitCheck();
 
-            transactions->push_back(x.second);
-            if (++i == getNode()->getMaxTransactionsPerBlock())
-                break;
+        auto nowMs = Schain::getCurrentTimeMs();
+
+        uint64_t deadlineMs;
+
+        if (nowMs < earliestMs) {
+            deadlineMs = earliestMs;
+        } else {
+            auto pending = (uint64_t) insertedTransactionsCount;
+
+            if (pending >= batchSize || (pending > 0 && nowMs >= latencyDeadlineMs) ||
+                nowMs >= emptyBlockDeadlineMs)
+                return;
+
+            deadlineMs = pending > 0 ? min(latencyDeadlineMs, emptyBlockDeadlineMs) : emptyBlockDeadlineMs;
         }
+
+        proposalCond.wait_for(lock, chrono::milliseconds(deadlineMs - nowMs));
     }
-    return transactions;
 }
 
-void PendingTransactionsAgent::waitUntilPendingTransaction() {
-    for (uint64_t i = 0; i < getNode()->getEmptyBlockIntervalMs(); i++) {
-        getSchain()->getNode()->exitCheck();
-        // unlock before sleep
-        {
-            lock_guard<recursive_mutex> lock(transactionsMutex);
-            if (pendingTransactions.size() > 0) {
-                break;
+
+void PendingTransactionsAgent::notifyProposalThreshold(uint64_t _pendingCount) {
+
+    // only the first transaction and the one completing a batch can change the outcome of the wait
+    if (_pendingCount != 1 && _pendingCount != getNode()->getProposalBatchSize())
+        return;
+
+    {
+        lock_guard<mutex> lock(proposalMutex);
+    }
+
+    proposalCond.notify_all();
+}
+
+
+void PendingTransactionsAgent::notifyAllConditionVariables() {
+    Agent::notifyAllConditionVariables();
+    {
+        lock_guard<mutex> lock(proposalMutex);
+    }
+    proposalCond.notify_all();
+    {
+        lock_guard<mutex> lock(spaceMutex);
+    }
+    spaceCond.notify_all();
+}
+
+
+PendingTransactionsAgent::TransactionShard &PendingTransactionsAgent::getShard(uint64_t _key) {
+    return shards[getShardIndex(_key)];
+}
+
+
+uint64_t PendingTransactionsAgent::getShardIndex(uint64_t _key) const {
+    return shardHash(_key) % MEMPOOL_SHARD_COUNT;
+}
+
+
+void PendingTransactionsAgent::indexStagedTransactions() {
+
+    for (auto &&shard : shards) {
+
+        lock_guard<mutex> shardLock(shard.shardMutex);
+
+        if (shard.staged.empty())
+            continue;
+
+        lock_guard<mutex> indexLock(indexMutex);
+
+        for (auto &&staged : shard.staged) {
+            // transactions committed after they were staged are no longer pending
+            if (shard.pendingTransactions.get(staged.key) == staged.transaction) {
+                mempoolIndex->add(staged.key, staged.priority, staged.sequence, staged.transaction);
             }
         }
 
-        usleep(1000);
+        shard.staged.clear();
     }
 }
 
@@ -178,126 +532,286 @@ void PendingTransactionsAgent::pushKnownTransactions(ptr<vector<ptr<Transaction>
 }
 
 
-void PendingTransactionsAgent::pushTransactions(ptr<vector<ptr<Transaction>>> _transactions) {
-    lock_guard<recursive_mutex> lock(transactionsMutex);
+vector<push_status> PendingTransactionsAgent::pushTransactions(ptr<vector<ptr<Transaction>>> _transactions) {
+    TransactionHashingPool::hashTransactions(*_transactions);
+    vector<push_status> statuses;
+    statuses.reserve(_transactions->size());
     for (auto &&t: *_transactions) {
-        pushTransaction(t);
+        statuses.push_back(pushTransaction(t));
+    }
+    return statuses;
+}
+
+
+vector<push_status> PendingTransactionsAgent::pushTransactions(ptr<vector<ptr<Transaction>>> _transactions,
+                                                               const vector<uint64_t> &_priorities) {
+    ASSERT(_priorities.size() == _transactions->size());
+    TransactionHashingPool::hashTransactions(*_transactions);
+    vector<push_status> statuses;
+    statuses.reserve(_transactions->size());
+    for (uint64_t i = 0; i < _transactions->size(); i++) {
+        statuses.push_back(pushTransaction((*_transactions)[i], _priorities[i]));
     }
+    return statuses;
 }
 
 
 ptr<Transaction> PendingTransactionsAgent::getKnownTransactionByPartialHash(ptr<partial_sha_hash> hash) {
-    lock_guard<recursive_mutex> lock(transactionsMutex);
-    if (pendingTransactions.count(hash))
-        return pendingTransactions[hash];
-    if (knownTransactions.count(hash))
-        return knownTransactions[hash];
-    return nullptr;
+
+    auto key = CommittedTransactionFilter::toKey(*hash);
+
+    auto &shard = getShard(key);
+
+    lock_guard<mutex> lock(shard.shardMutex);
+
+    auto transaction = shard.pendingTransactions.get(key);
+
+    if (transaction)
+        return transaction;
+
+    return shard.knownTransactions.get(key);
 }
 
 
-void PendingTransactionsAgent::pushTransaction(ptr<Transaction> _transaction) {
+void PendingTransactionsAgent::getKnownTransactionsByPartialHashes(ptr<PartialHashesList> _hashes,
+                                                                   vector<ptr<Transaction>> &_result) {
+
+    auto count = (uint64_t) _hashes->getTransactionCount();
+
+    _result.assign(count, nullptr);
+
+    vector<uint64_t> keys(count);
+
+    // group the indices by shard so that each shard lock is taken once
+    array<vector<uint64_t>, MEMPOOL_SHARD_COUNT> indices;
+
+    for (uint64_t i = 0; i < count; i++) {
+        keys[i] = _hashes->getPartialHashKey(i);
+        indices[getShardIndex(keys[i])].push_back(i);
+    }
+
+    for (uint64_t s = 0; s < MEMPOOL_SHARD_COUNT; s++) {
+
+        if (indices[s].empty())
+            continue;
+
+        auto &shard = shards[s];
+
+        lock_guard<mutex> lock(shard.shardMutex);
 
-    while (pendingTransactions.size() > getNode()->getMaxTransactionsPerBlock()) {
-        usleep(10000);
-        if(getNode()->isExitRequested()) {
-            return;
+        for (auto i : indices[s]) {
+            auto transaction = shard.pendingTransactions.get(keys[i]);
+            _result[i] = transaction ? transaction : shard.knownTransactions.get(keys[i]);
         }
     }
+}
+
+
+push_status PendingTransactionsAgent::pushTransaction(ptr<Transaction> _transaction) {
+    return pushTransaction(_transaction, 0);
+}
+
+
+push_status PendingTransactionsAgent::pushTransaction(ptr<Transaction> _transaction, uint64_t _priority) {
+
+    push_status status;
+
+    while ((status = tryPushTransaction(_transaction, _priority)) == PUSH_QUEUE_FULL) {
+        waitForSpace(PENDING_QUEUE_WAIT_MS);
+        if (getNode()->isExitRequested()) {
+            return status;
+        }
+    }
+
+    notifyPendingQueueWatermark();
+
+    return status;
+}
+
+
+push_status PendingTransactionsAgent::tryPushTransaction(ptr<Transaction> _transaction, uint64_t _priority) {
 
     ASSERT(_transaction);
+
+    auto size = _transaction->getData()->size();
+
+    // reserve first, concurrent pushers can not overshoot the limits
+    uint64_t inserted;
+
+    auto count = ++pendingTransactionsCount;
+    auto bytes = (pendingTransactionsBytes += size);
+
+    if (count > getNode()->getMaxPendingTransactions() ||
+        (bytes > getNode()->getMaxPendingTransactionBytes() && count > 1)) {
+        pendingTransactionsCount--;
+        pendingTransactionsBytes -= size;
+        markPendingQueueFull();
+        return PUSH_QUEUE_FULL;
+    }
+
+    auto key = _transaction->getPartialHashKey();
+
+    if (isCommitted(key)) {
+        LOG(info, "Committed transaction pushed to pending");
+        releasePending(1, size);
+        return PUSH_REJECTED;
+    }
+
     {
+        auto &shard = getShard(key);
 
-        lock_guard<recursive_mutex> lock(transactionsMutex);
-        if (pendingTransactions.count(_transaction->getPartialHash())) {
+        lock_guard<mutex> lock(shard.shardMutex);
+
+        if (!shard.pendingTransactions.insert(key, _transaction)) {
             LOG(info, "Duplicate transaction pushed to pending transactions");
-            return;
+            releasePending(1, size);
+            return PUSH_REJECTED;
         }
-        if (isCommitted(_transaction->getPartialHash())) {
-            LOG(info, "Committed transaction pushed to pending");
-            return;
-        }
-        pendingTransactions[_transaction->getPartialHash()] = _transaction;
-    }
-}
 
-void PendingTransactionsAgent::pushKnownTransaction(ptr<Transaction> _transaction) {
-    lock_guard<recursive_mutex> lock(transactionsMutex);
-    if (knownTransactions.count(_transaction->getPartialHash())) {
-        LOG(trace, "Duplicate transaction pushed to known transactions");
-        return;
+        shard.staged.push_back({key, _priority, arrivalSequence++, _transaction});
+
+        inserted = ++insertedTransactionsCount;
     }
-    knownTransactions[_transaction->getPartialHash()] = _transaction;
 
+    notifyProposalThreshold(inserted);
 
-    while (knownTransactions.size() > KNOWN_TRANSACTIONS_HISTORY) {
-        auto t1 = knownTransactions.begin()->first;
-        knownTransactions.erase(t1);
+    return PUSH_ACCEPTED;
+}
+
+
+void PendingTransactionsAgent::markPendingQueueFull() {
+    if (!pendingQueueFull.exchange(true)) {
+        LOG(debug, "Pending queue full");
     }
 }
 
 
-transaction_count PendingTransactionsAgent::getTransactionCounter() const {
-    return transactionCounter;
+void PendingTransactionsAgent::releasePending(uint64_t _count, uint64_t _bytes) {
+    pendingTransactionsCount -= _count;
+    pendingTransactionsBytes -= _bytes;
+    checkLowWatermark();
 }
 
-uint64_t PendingTransactionsAgent::getKnownTransactionsSize() {
-    lock_guard<recursive_mutex> lock(transactionsMutex);
-    return knownTransactions.size();
+
+void PendingTransactionsAgent::checkLowWatermark() {
+
+    if (!pendingQueueFull)
+        return;
+
+    if (pendingTransactionsCount * 100 > getNode()->getMaxPendingTransactions() *
+                                         PENDING_TRANSACTIONS_LOW_WATERMARK_PERCENT ||
+        pendingTransactionsBytes * 100 > getNode()->getMaxPendingTransactionBytes() *
+                                         PENDING_TRANSACTIONS_LOW_WATERMARK_PERCENT)
+        return;
+
+    if (!pendingQueueFull.exchange(false))
+        return;
+
+    LOG(debug, "Pending queue drained");
+
+    {
+        lock_guard<mutex> lock(spaceMutex);
+    }
+
+    spaceCond.notify_all();
 }
 
 
+bool PendingTransactionsAgent::waitForSpace(uint64_t _timeoutMs) {
 
-uint64_t PendingTransactionsAgent::getPendingTransactionsSize() {
-    lock_guard<recursive_mutex> lock(transactionsMutex);
-    return pendingTransactions.size();
+    // an exactly full queue is not marked yet, the wait would return at once
+    if (getFreeSlots() == 0)
+        markPendingQueueFull();
+
+    notifyPendingQueueWatermark();
+
+    unique_lock<mutex> lock(spaceMutex);
+    return spaceCond.wait_for(lock, chrono::milliseconds(_timeoutMs), [this]() {
+        return !pendingQueueFull || getNode()->isExitRequested();
+    });
 }
 
 
-uint64_t PendingTransactionsAgent::getCommittedTransactionsSize() {
-    lock_guard<recursive_mutex> lock(transactionsMutex);
-    return committedTransactions.size();
+uint64_t PendingTransactionsAgent::getFreeSlots() const {
+    uint64_t count = pendingTransactionsCount;
+    auto max = sChain->getNode()->getMaxPendingTransactions();
+    return count < max ? max - count : 0;
 }
 
-bool PendingTransactionsAgent::isCommitted(ptr<partial_sha_hash> _hash) {
-    lock_guard<recursive_mutex> lock(transactionsMutex);
-   auto isCommitted = committedTransactions.count(_hash ) > 0;
-        return isCommitted;
+
+void PendingTransactionsAgent::notifyPendingQueueWatermark() {
+
+    auto extFace = getSchain()->getExtFace();
+
+    if (!extFace)
+        return;
+
+    lock_guard<recursive_mutex> lock(watermarkMutex);
+
+    // the state can flip again while the callback runs, report until the host is up to date
+    while (reportedQueueFull != pendingQueueFull) {
+        reportedQueueFull = !reportedQueueFull;
+        extFace->pendingQueueWatermark(reportedQueueFull);
+    }
 }
 
+void PendingTransactionsAgent::pushKnownTransaction(ptr<Transaction> _transaction) {
 
-void PendingTransactionsAgent::pushCommittedTransaction(shared_ptr<Transaction> t) {
-    lock_guard<recursive_mutex> lock(transactionsMutex);
-    committedTransactions.insert(t->getPartialHash());
-    committedTransactionsList.push_back(t->getPartialHash());
-    while (committedTransactions.size() > getNode()->getCommittedTransactionHistoryLimit()) {
-        committedTransactions.erase(committedTransactionsList.front());
-        committedTransactionsList.pop_front();
+    auto key = _transaction->getPartialHashKey();
+
+    auto &shard = getShard(key);
+
+    lock_guard<mutex> lock(shard.shardMutex);
+
+    if (!shard.knownTransactions.insert(key, _transaction)) {
+        LOG(trace, "Duplicate transaction pushed to known transactions");
+        return;
     }
 
-    ASSERT(committedTransactionsList.size() >= committedTransactions.size());
+    knownTransactionsCount++;
 
-    auto db = getNode()->getCommittedTransactionsDB();
+    shard.knownOrder.push_back(key);
 
+    // oldest first, entries already removed on commit are skipped
+    while (shard.knownOrder.size() > KNOWN_TRANSACTIONS_HISTORY / MEMPOOL_SHARD_COUNT + 1) {
+        if (shard.knownTransactions.erase(shard.knownOrder.front()))
+            knownTransactionsCount--;
+        shard.knownOrder.pop_front();
+    }
+}
 
-    auto key = (const char *) t->getPartialHash()->data();
-    auto keyLen = PARTIAL_SHA_HASH_LEN;
-    auto value = (const char*) &committedTransactionCounter;
-    auto valueLen = sizeof(committedTransactionCounter);
 
+transaction_count PendingTransactionsAgent::getTransactionCounter() const {
+    return transactionCounter;
+}
 
-    db->writeByteArray(key, keyLen, value, valueLen);
+uint64_t PendingTransactionsAgent::getKnownTransactionsSize() {
+    return knownTransactionsCount;
+}
 
-    static auto key1 = string("transactions");
-    auto value1 = to_string(committedTransactionCounter);
 
-    db->writeString(key1, value1);
 
-    committedTransactionCounter++;
+uint64_t PendingTransactionsAgent::getPendingTransactionsSize() {
+    return pendingTransactionsCount;
+}
+
+
+uint64_t PendingTransactionsAgent::getCommittedTransactionsSize() {
+    shared_lock<shared_mutex> lock(committedMutex);
+    return committedTransactions->getSize();
+}
 
+bool PendingTransactionsAgent::isCommitted(ptr<partial_sha_hash> _hash) {
+    shared_lock<shared_mutex> lock(committedMutex);
+    return committedTransactions->contains(*_hash);
+}
 
+bool PendingTransactionsAgent::isCommitted(uint64_t _key) {
+    shared_lock<shared_mutex> lock(committedMutex);
+    return committedTransactions->contains(_key);
 }
 
+
 uint64_t PendingTransactionsAgent::getCommittedTransactionCounter() const {
     return committedTransactionCounter;
 }
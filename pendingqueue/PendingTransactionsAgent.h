@@ -32,14 +32,32 @@ class BlockProposal;
 class PartialHashesList;
 class Transaction;
 
+#include <shared_mutex>
+
 #include "../db/LevelDB.h"
+#include "CommittedTransactionFilter.h"
+#include "TransactionMap.h"
+#include "MempoolIndex.h"
 
-class PendingTransactionsAgent : Agent, LevelDB::KeyVisitor {
+class PendingTransactionsAgent : Agent {
 
 
 public:
 private:
-    void visitDBKey(leveldb::Slice key) override;
+    /**
+     * Loads the newest per-block committed transaction records up to the history limit
+     */
+    void loadCommittedTransactions();
+
+    /**
+     * Loads the filter snapshot and replays only the records committed after it
+     */
+    bool loadCommittedTransactionsFromSnapshot();
+
+    /**
+     * Converts the old one-key-per-transaction layout into a single record
+     */
+    void migrateLegacyCommittedTransactions();
 
 public:
 
@@ -89,19 +107,108 @@ private:
     };
 
 
-    unordered_map<ptr<partial_sha_hash>, ptr<Transaction>, Hasher, Equal> pendingTransactions;
-    unordered_set<ptr<partial_sha_hash>, Hasher, Equal> committedTransactions;
-    unordered_map<ptr<partial_sha_hash>, ptr<Transaction> , Hasher, Equal> knownTransactions;
+    class StagedTransaction {
+    public:
+        uint64_t key;
+
+        uint64_t priority;
+
+        uint64_t sequence;
+
+        ptr<Transaction> transaction;
+    };
+
+    /**
+     * Pending and known transactions are sharded by partial hash, a shard lock guards both maps
+     */
+    class TransactionShard {
+    public:
+        mutex shardMutex;
+
+        TransactionMap pendingTransactions;
+
+        TransactionMap knownTransactions;
+
+        // eviction order of known transactions
+        deque<uint64_t> knownOrder;
+
+        // pending transactions not yet in the mempool index, so pushers never take indexMutex
+        vector<StagedTransaction> staged;
+    };
+
+    array<TransactionShard, MEMPOOL_SHARD_COUNT> shards;
+
+    SeededHash shardHash;
+
+    // arrival order across all shards
+    atomic<uint64_t> arrivalSequence;
+
+    // count and bytes are reserved before a transaction is inserted, so they bound the pending queue
+    atomic<uint64_t> pendingTransactionsCount;
+
+    atomic<uint64_t> pendingTransactionsBytes;
+
+    // transactions in the shards, changed under the shard lock, so it never counts a reservation
+    // the proposer can not select yet
+    atomic<uint64_t> insertedTransactionsCount;
+
+    atomic<bool> pendingQueueFull;
+
+    // last watermark state reported to the ExtFace, recursive since the host may push from the callback
+    recursive_mutex watermarkMutex;
+
+    bool reportedQueueFull = false;
+
+    mutex spaceMutex;
 
-    list<ptr<partial_sha_hash>> committedTransactionsList;
+    condition_variable spaceCond;
+
+    void releasePending(uint64_t _count, uint64_t _bytes);
+
+    void markPendingQueueFull();
+
+    void checkLowWatermark();
+
+    atomic<uint64_t> knownTransactionsCount;
+
+    // proposal order of pending transactions, indexMutex is never held while taking another lock
+    ptr<MempoolIndex> mempoolIndex;
+
+    mutex indexMutex;
+
+    /**
+     * Moves the staged transactions of every shard to the mempool index
+     */
+    void indexStagedTransactions();
+
+    TransactionShard &getShard(uint64_t _key);
+
+    uint64_t getShardIndex(uint64_t _key) const;
+
+    // writers hold transactionsMutex and committedMutex, readers hold either of them.
+    // Lock order is transactionsMutex, committedMutex, shard locks, indexMutex
+    ptr<CommittedTransactionFilter> committedTransactions;
+
+    shared_mutex committedMutex;
 
     transaction_count transactionCounter = 0;
 
     uint64_t committedTransactionCounter = 0;
 
+    uint64_t lastCommittedBlockID = 0;
+
+    uint64_t lastSnapshotBlockID = 0;
+
 
     recursive_mutex transactionsMutex;
 
+    // signalled by pushTransaction when a proposal threshold may have been reached
+    mutex proposalMutex;
+
+    condition_variable proposalCond;
+
+    void notifyProposalThreshold(uint64_t _pendingCount);
+
 
 public:
 
@@ -111,15 +218,54 @@ public:
 
     transaction_count getTransactionCounter() const;
 
-    void pushTransaction(ptr<Transaction> _transaction);
+    /**
+     * Never blocks. PUSH_REJECTED for duplicate and committed transactions,
+     * PUSH_QUEUE_FULL if the pending queue is at its count or byte limit.
+     * The caller reports watermark changes through notifyPendingQueueWatermark
+     */
+    push_status tryPushTransaction(ptr<Transaction> _transaction, uint64_t _priority = 0);
+
+    /**
+     * Blocking variant of tryPushTransaction, waits while the pending queue is full.
+     * Returns PUSH_QUEUE_FULL only if exit was requested while waiting
+     */
+    push_status pushTransaction(ptr<Transaction> _transaction);
+
+    push_status pushTransaction(ptr<Transaction> _transaction, uint64_t _priority);
+
+    /**
+     * Waits until the pending queue drains below the low watermark, returns false on timeout.
+     * A queue without free slots counts as full even if no push has failed yet
+     */
+    bool waitForSpace(uint64_t _timeoutMs);
+
+    uint64_t getFreeSlots() const;
+
+    /**
+     * Reports pending queue watermark changes to the ExtFace. The watermark itself changes under
+     * consensus locks, so this is only called once they are released
+     */
+    void notifyPendingQueueWatermark();
 
     void pushKnownTransaction(ptr<Transaction> _transaction);
 
     void pushKnownTransactions(ptr<vector<ptr<Transaction>>> _transactions);
 
-    void pushTransactions(ptr<vector<ptr<Transaction>>> _transactions);
+    /**
+     * Returns the status of each transaction
+     */
+    vector<push_status> pushTransactions(ptr<vector<ptr<Transaction>>> _transactions);
+
+    vector<push_status> pushTransactions(ptr<vector<ptr<Transaction>>> _transactions,
+                                         const vector<uint64_t> &_priorities);
 
-    void waitUntilPendingTransaction();
+    /**
+     * Waits until enough transactions are pending or a pending transaction has waited long enough.
+     * Returns after the empty block interval if nothing arrives
+     */
+    void waitUntilPendingTransaction(uint64_t _startTimeMs);
+
+    void notifyAllConditionVariables() override;
 
     uint64_t getKnownTransactionsSize();
 
@@ -130,20 +276,34 @@ public:
 
     bool isCommitted(ptr< partial_sha_hash > _hash);
 
-    void pushCommittedTransaction(shared_ptr<Transaction> t);
+    bool isCommitted(uint64_t _key);
+
+    /**
+     * Serializes the committed filter, _blockID is set to the last block it covers
+     */
+    ptr<string> createCommittedFilterSnapshot(uint64_t &_blockID);
 
 
     shared_ptr<vector<ptr<Transaction>>> createTransactionsListForProposal();
 
     ptr<Transaction> getKnownTransactionByPartialHash(ptr<partial_sha_hash> hash);
 
+    /**
+     * Batch lookup, takes each shard lock once. _result[i] is nullptr for unknown transactions
+     */
+    void getKnownTransactionsByPartialHashes(ptr<PartialHashesList> _hashes, vector<ptr<Transaction>> &_result);
+
 
     void cleanCommittedTransactionsFromQueue(ptr<BlockProposal> _committedBlockProposal);
 
-    ptr<BlockProposal> buildBlockProposal(block_id _blockID, uint64_t  _previousBlockTimeStamp);
+    ptr<BlockProposal> buildBlockProposal(block_id _blockID, uint64_t  _previousBlockTimeStamp,
+                                          uint32_t _previousBlockTimeStampMs);
 
 
-    void addToCommitted(shared_ptr<partial_sha_hash> &s);
+    /**
+     * Records are keyed by big endian block id, so they are stored in commit order
+     */
+    static string createCommittedTransactionsKey(uint64_t _blockID);
 
 
 };
@@ -0,0 +1,67 @@
+/*
+    Copyright (C) 2019 SKALE Labs
+
+    This file is part of skale-consensus.
+
+    skale-consensus is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    skale-consensus is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with skale-consensus.  If not, see <http://www.gnu.org/licenses/>.
+
+    @file SeededHash.h
+    @author Stan Kladko
+    @date 2019
+*/
+
+
+#pragma once
+
+
+/**
+ * Hash for partial transaction hashes. Partial hashes can be ground by clients, so table slots and
+ * shards are derived from a splitmix64 mix of the key with a per process random seed.
+ * Also usable as the hasher of standard unordered containers.
+ */
+class SeededHash {
+
+    uint64_t seed;
+
+public:
+
+    SeededHash();
+
+    uint64_t operator()(uint64_t _key) const {
+        uint64_t x = _key ^ seed;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    /**
+     * Backward shift deletion for linear probing tables of size _mask + 1. Moves the entries following
+     * slot _i back so that probe sequences stay intact without tombstones. Returns the slot to clear
+     */
+    template<typename IsEmpty, typename HomeSlot, typename MoveEntry>
+    static uint64_t shiftBack(uint64_t _i, uint64_t _mask, IsEmpty &&_isEmpty, HomeSlot &&_homeSlot,
+                              MoveEntry &&_moveEntry) {
+        auto j = _i;
+        while (true) {
+            j = (j + 1) & _mask;
+            if (_isEmpty(j))
+                return _i;
+            auto k = _homeSlot(j);
+            if ((j > _i && (k <= _i || k > j)) || (j < _i && (k <= _i && k > j))) {
+                _moveEntry(_i, j);
+                _i = j;
+            }
+        }
+    }
+};
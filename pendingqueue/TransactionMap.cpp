@@ -0,0 +1,133 @@
+/*
+    Copyright (C) 2019 SKALE Labs
+
+    This file is part of skale-consensus.
+
+    skale-consensus is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    skale-consensus is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with skale-consensus.  If not, see <http://www.gnu.org/licenses/>.
+
+    @file TransactionMap.cpp
+    @author Stan Kladko
+    @date 2019
+*/
+
+
+#include "../SkaleConfig.h"
+#include "../Log.h"
+#include "../exceptions/FatalError.h"
+#include "../datastructures/Transaction.h"
+
+#include "TransactionMap.h"
+
+
+TransactionMap::TransactionMap(uint64_t _initialCapacity) {
+
+    uint64_t capacity = 16;
+    while (capacity < _initialCapacity * 2) {
+        capacity *= 2;
+    }
+
+    entries.resize(capacity);
+    mask = capacity - 1;
+}
+
+
+uint64_t TransactionMap::slotOf(uint64_t _key) const {
+    return hash(_key) & mask;
+}
+
+
+ptr<Transaction> TransactionMap::get(uint64_t _key) const {
+    for (auto i = slotOf(_key);; i = (i + 1) & mask) {
+        auto &entry = entries[i];
+        if (!entry.value)
+            return nullptr;
+        if (entry.key == _key)
+            return entry.value;
+    }
+}
+
+
+bool TransactionMap::contains(uint64_t _key) const {
+    return get(_key) != nullptr;
+}
+
+
+bool TransactionMap::insert(uint64_t _key, const ptr<Transaction> &_value) {
+
+    ASSERT(_value);
+
+    if ((size + 1) * 2 > entries.size()) {
+        grow();
+    }
+
+    auto i = slotOf(_key);
+
+    while (entries[i].value) {
+        if (entries[i].key == _key)
+            return false;
+        i = (i + 1) & mask;
+    }
+
+    entries[i].key = _key;
+    entries[i].value = _value;
+    size++;
+
+    return true;
+}
+
+
+bool TransactionMap::erase(uint64_t _key) {
+
+    auto i = slotOf(_key);
+
+    while (true) {
+        if (!entries[i].value)
+            return false;
+        if (entries[i].key == _key)
+            break;
+        i = (i + 1) & mask;
+    }
+
+    i = SeededHash::shiftBack(i, mask, [this](uint64_t _j) { return !entries[_j].value; },
+                              [this](uint64_t _j) { return slotOf(entries[_j].key); },
+                              [this](uint64_t _to, uint64_t _from) { entries[_to] = std::move(entries[_from]); });
+
+    entries[i].value = nullptr;
+    size--;
+
+    return true;
+}
+
+
+void TransactionMap::grow() {
+
+    vector<Entry> old(entries.size() * 2);
+    old.swap(entries);
+    mask = entries.size() - 1;
+
+    for (auto &&entry : old) {
+        if (!entry.value)
+            continue;
+        auto i = slotOf(entry.key);
+        while (entries[i].value) {
+            i = (i + 1) & mask;
+        }
+        entries[i] = std::move(entry);
+    }
+}
+
+
+uint64_t TransactionMap::getSize() const {
+    return size;
+}
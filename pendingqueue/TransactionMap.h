@@ -0,0 +1,88 @@
+/*
+    Copyright (C) 2019 SKALE Labs
+
+    This file is part of skale-consensus.
+
+    skale-consensus is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    skale-consensus is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with skale-consensus.  If not, see <http://www.gnu.org/licenses/>.
+
+    @file TransactionMap.h
+    @author Stan Kladko
+    @date 2019
+*/
+
+
+#pragma once
+
+
+#include "SeededHash.h"
+
+
+class Transaction;
+
+
+/**
+ * Flat open addressing map from the partial transaction hash, stored inline as uint64, to the transaction.
+ * Linear probing keeps lookups within one or two cache lines, deletions shift entries back
+ * instead of leaving tombstones. Not thread safe, callers synchronize.
+ */
+class TransactionMap {
+
+    class Entry {
+    public:
+        uint64_t key = 0;
+
+        // nullptr marks an empty slot
+        ptr<Transaction> value = nullptr;
+    };
+
+    vector<Entry> entries;
+
+    uint64_t mask;
+
+    SeededHash hash;
+
+    uint64_t size = 0;
+
+    uint64_t slotOf(uint64_t _key) const;
+
+    void grow();
+
+public:
+
+    explicit TransactionMap(uint64_t _initialCapacity = 16);
+
+    ptr<Transaction> get(uint64_t _key) const;
+
+    bool contains(uint64_t _key) const;
+
+    /**
+     * Returns false and keeps the existing transaction if the key is present
+     */
+    bool insert(uint64_t _key, const ptr<Transaction> &_value);
+
+    bool erase(uint64_t _key);
+
+    uint64_t getSize() const;
+
+    /**
+     * Calls _visitor(key, transaction) for every entry until it returns false
+     */
+    template<typename Visitor>
+    void visit(Visitor &&_visitor) const {
+        for (auto &&entry : entries) {
+            if (entry.value && !_visitor(entry.key, entry.value))
+                return;
+        }
+    }
+};
@@ -487,6 +487,9 @@ void BinConsensusInstance::proceedWithNewRound(bin_consensus_value value) {
 
     commitValueIfTwoThirds(m);
 
+    getSchain()->getNode()->getNetwork()->releaseDeferredMessages(getBlockID(), getBlockProposerIndex(),
+                                                                   currentRound);
+
 
 }
 
@@ -519,6 +522,9 @@ void BinConsensusInstance::decide(bin_consensus_value b) {
 
     addDecideToHistory(currentRound, decidedValue);
 
+    getSchain()->getNode()->getNetwork()->releaseDeferredMessages(getBlockID(), getBlockProposerIndex(),
+                                                                   currentRound);
+
     {
         lock_guard<recursive_mutex> lock(historyMutex);
 
@@ -120,8 +120,28 @@ void BlockConsensusAgent::processChildMessageImpl(ptr<InternalMessageEnvelope> _
 
     auto m = dynamic_pointer_cast<ChildBVDecidedMessage>(_me->getMessage());
 
+    auto blockID = m->getBlockId();
 
-    voteAndDecideIfNeded(m);
+    schain_index proposerIndex;
+
+    {
+        lock_guard<recursive_mutex> lock(decisionsMutex);
+
+        if (decidedBlocks.count(blockID) > 0)
+            return;
+
+        voteAndDecideIfNeded(m);
+
+        auto decision = decidedBlocks.find(blockID);
+
+        if (decision == decidedBlocks.end())
+            return;
+
+        proposerIndex = decision->second;
+    }
+
+    // waiting for the proposal and committing may take long, other consensus threads must not block on it
+    commitDecidedBlock(blockID, proposerIndex);
 }
 
 void BlockConsensusAgent::propose(bin_consensus_value _proposal, schain_index _index, block_id _id) {
@@ -141,7 +161,8 @@ void BlockConsensusAgent::propose(bin_consensus_value _proposal, schain_index _i
     auto id = (uint64_t) msg->getBlockId();
     ASSERT( id != 0);
 
-    child->processParentProposal(make_shared<InternalMessageEnvelope>(ORIGIN_PARENT, msg, *getSchain()));
+    // processed by the consensus thread that owns this instance
+    getSchain()->postMessage(make_shared<InternalMessageEnvelope>(ORIGIN_PARENT, msg, *getSchain()));
 
 }
 
@@ -160,8 +181,11 @@ void BlockConsensusAgent::decideBlock(block_id _blockNumber, schain_index _propo
     LOG(info, "Total transactions:" + to_string(getSchain()->getTotalTransactions()) +
               " Time(s):" +
               to_string((getSchain()->getCurrentTimeMilllis().count() - getSchain()->getStartTime().count()) / 1000.0));
+}
 
 
+void BlockConsensusAgent::commitDecidedBlock(block_id _blockNumber, schain_index _proposerIndex) {
+
     auto proposedBlockSet = getSchain()->blockProposalsDatabase->getProposedBlockSet(_blockNumber);
 
 
@@ -174,11 +198,14 @@ void BlockConsensusAgent::decideBlock(block_id _blockNumber, schain_index _propo
 
     if (_proposerIndex == (uint64_t ) getSchain()->getNodeCount()) { // empty block
         auto emptyList = make_shared<TransactionList>(make_shared<vector<ptr<Transaction>>>());
-        auto zeroProposal = make_shared<ReceivedBlockProposal> (*getSchain(), _blockNumber, _proposerIndex,
-                 emptyList, Schain::getCurrentTimeSec());
 
+        // the time stamp enters the block hash, so derive it from the previous committed block instead of
+        // the local clock
+        auto timeStampMs = getSchain()->getCommittedBlockTimeStamp() * 1000 +
+                           getSchain()->getCommittedBlockTimeStampMs() + 1;
+        auto zeroProposal = make_shared<ReceivedBlockProposal> (*getSchain(), _blockNumber, _proposerIndex,
+                 emptyList, timeStampMs / 1000, (uint32_t) (timeStampMs % 1000));
 
-        //TODO: FIX TIME FOR EMPTY PROPOSAL!!!
         proposedBlockSet->addProposal(zeroProposal);
     }
 
@@ -193,7 +220,8 @@ void BlockConsensusAgent::decideBlock(block_id _blockNumber, schain_index _propo
 
     auto proposal = proposedBlockSet->getProposalByIndex(_proposerIndex);
 
-    getSchain()->blockCommitArrived(false, _blockNumber, _proposerIndex, proposal->getTimeStamp());
+    getSchain()->blockCommitArrived(false, _blockNumber, _proposerIndex, proposal->getTimeStamp(),
+                                    proposal->getTimeStampMs());
 
 }
 
@@ -325,8 +353,6 @@ void BlockConsensusAgent::routeAndProcessMessage(ptr<MessageEnvelope> m) {
 
     ASSERT(m->getMessage()->getBlockId() > 0);
 
-    ASSERT(m->getOrigin() != ORIGIN_PARENT);
-
 
     if (m->getMessage()->getMessageType() == MSG_CONSENSUS_PROPOSAL) {
 
@@ -359,13 +385,19 @@ void BlockConsensusAgent::routeAndProcessMessage(ptr<MessageEnvelope> m) {
 
         {
 
-            if (completedInstancesByProtocolKey.count((key))) {
-                return;
+            {
+                lock_guard<recursive_mutex> lock(childrenMutex);
+                if (completedInstancesByProtocolKey.count((key))) {
+                    return;
+                }
             }
 
             auto child = getChild(key);
 
             if (child != nullptr) {
+                if (m->getOrigin() == ORIGIN_PARENT) {
+                    return child->processParentProposal(dynamic_pointer_cast<InternalMessageEnvelope>(m));
+                }
                 return child->processMessage(m);
             }
         }
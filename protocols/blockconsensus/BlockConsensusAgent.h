@@ -59,6 +59,11 @@ class BlockConsensusAgent {
 
     recursive_mutex childrenMutex;
 
+    /**
+     * Serializes decisions of binary consensus instances that run on different consensus threads
+     */
+    recursive_mutex decisionsMutex;
+
     map<ptr<ProtocolKey>, ptr<BinConsensusInstance>, Comparator> children;
 
 
@@ -78,8 +83,16 @@ class BlockConsensusAgent {
 
     void processChildMessageImpl(ptr<InternalMessageEnvelope> _me);
 
+    /**
+     * Records the decision, called with decisionsMutex held
+     */
     void decideBlock(block_id _blockNumber, schain_index subChainIndex);
 
+    /**
+     * Waits for the decided proposal and commits it, called without decisionsMutex
+     */
+    void commitDecidedBlock(block_id _blockNumber, schain_index _proposerIndex);
+
 
     void propose(bin_consensus_value _proposal, schain_index index, block_id _id);
 
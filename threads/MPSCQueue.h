@@ -0,0 +1,176 @@
+/*
+    Copyright (C) 2018-2019 SKALE Labs
+
+    This file is part of skale-consensus.
+
+    skale-consensus is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    skale-consensus is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with skale-consensus.  If not, see <http://www.gnu.org/licenses/>.
+
+    @file MPSCQueue.h
+    @author Stan Kladko
+    @date 2018
+*/
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "../SkaleConfig.h"
+
+
+/**
+ * Unbounded lock-free multi-producer single-consumer queue.
+ * Producers never block, the consumer drains everything available in one call
+ * and sleeps on an eventfd that producers only signal when the consumer is asleep.
+ */
+template<typename T>
+class MPSCQueue {
+
+    class Item {
+    public:
+        atomic<Item *> next;
+        T value;
+
+        Item() : next(nullptr) {}
+
+        explicit Item(T _value) : next(nullptr), value(std::move(_value)) {}
+    };
+
+    // producers append here
+    atomic<Item *> head;
+
+    // consumer side, always points to an already consumed item
+    Item *tail;
+
+    atomic<uint64_t> size;
+
+    atomic<bool> consumerWaiting;
+
+    int eventFD;
+
+public:
+
+    MPSCQueue() : size(0), consumerWaiting(false) {
+        tail = new Item();
+        head.store(tail);
+        eventFD = eventfd(0, EFD_NONBLOCK);
+        ASSERT(eventFD >= 0);
+    }
+
+    ~MPSCQueue() {
+        while (tail != nullptr) {
+            auto next = tail->next.load();
+            delete tail;
+            tail = next;
+        }
+        close(eventFD);
+    }
+
+    MPSCQueue(const MPSCQueue &) = delete;
+
+    MPSCQueue &operator=(const MPSCQueue &) = delete;
+
+
+    void push(T _value) {
+
+        auto item = new Item(std::move(_value));
+
+        size++;
+
+        auto previous = head.exchange(item);
+        previous->next.store(item, std::memory_order_release);
+
+        // pairs with the fence in wait(), either we see the consumer waiting or it sees the new item
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (consumerWaiting.load() && consumerWaiting.exchange(false)) {
+            wakeup();
+        }
+    }
+
+
+    /**
+     * Moves all available items to _out in FIFO order. Consumer thread only
+     */
+    uint64_t drain(vector<T> &_out) {
+
+        uint64_t count = 0;
+
+        while (true) {
+            auto next = tail->next.load(std::memory_order_acquire);
+            if (next == nullptr) {
+                break;
+            }
+            _out.push_back(std::move(next->value));
+            next->value = T();
+            delete tail;
+            tail = next;
+            count++;
+        }
+
+        size -= count;
+
+        return count;
+    }
+
+
+    bool isEmpty() const {
+        return tail->next.load(std::memory_order_acquire) == nullptr;
+    }
+
+
+    /**
+     * Blocks until an item may be available, wakeup() is called or the timeout expires. Consumer thread only
+     */
+    void wait(uint64_t _timeoutMs) {
+
+        consumerWaiting.store(true);
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (!isEmpty()) {
+            consumerWaiting.store(false);
+            return;
+        }
+
+        struct pollfd fd;
+        fd.fd = eventFD;
+        fd.events = POLLIN;
+        fd.revents = 0;
+
+        poll(&fd, 1, (int) _timeoutMs);
+
+        uint64_t counter;
+        auto result = read(eventFD, &counter, sizeof(counter));
+        (void) result;
+
+        consumerWaiting.store(false);
+    }
+
+
+    void wakeup() {
+        uint64_t one = 1;
+        auto result = write(eventFD, &one, sizeof(one));
+        (void) result;
+    }
+
+
+    uint64_t getSize() const {
+        return size;
+    }
+};
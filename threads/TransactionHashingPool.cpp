@@ -0,0 +1,137 @@
+/*
+    Copyright (C) 2019 SKALE Labs
+
+    This file is part of skale-consensus.
+
+    skale-consensus is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    skale-consensus is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with skale-consensus.  If not, see <http://www.gnu.org/licenses/>.
+
+    @file TransactionHashingPool.cpp
+    @author Stan Kladko
+    @date 2019
+*/
+
+
+#include "../SkaleConfig.h"
+#include "../Log.h"
+#include "../exceptions/FatalError.h"
+#include "../datastructures/Transaction.h"
+
+#include "TransactionHashingPool.h"
+
+
+TransactionHashingPool::TransactionHashingPool() {
+
+    auto threadCount = min((uint64_t) max(thread::hardware_concurrency(), 2u) - 1, MAX_TRANSACTION_HASHING_THREADS);
+
+    for (uint64_t i = 0; i < threadCount; i++) {
+        thread(&TransactionHashingPool::workerLoop, this).detach();
+    }
+}
+
+
+TransactionHashingPool &TransactionHashingPool::getInstance() {
+    // never destroyed, the detached workers may still be waiting on it at process exit
+    static auto instance = new TransactionHashingPool();
+    return *instance;
+}
+
+
+void TransactionHashingPool::hashTransactions(const vector<ptr<Transaction>> &_transactions) {
+
+    if (_transactions.size() < 2 * TRANSACTION_HASHING_CHUNK) {
+        runJob({&_transactions, 0, _transactions.size(), nullptr});
+        return;
+    }
+
+    getInstance().hash(_transactions);
+}
+
+
+void TransactionHashingPool::hash(const vector<ptr<Transaction>> &_transactions) {
+
+    auto completion = make_shared<Completion>();
+
+    auto chunks = (_transactions.size() + TRANSACTION_HASHING_CHUNK - 1) / TRANSACTION_HASHING_CHUNK;
+
+    completion->remaining = chunks;
+
+    {
+        lock_guard<mutex> lock(queueMutex);
+        for (uint64_t begin = 0; begin < _transactions.size(); begin += TRANSACTION_HASHING_CHUNK) {
+            queue.push_back({&_transactions, begin, min(begin + TRANSACTION_HASHING_CHUNK, _transactions.size()),
+                             completion});
+        }
+    }
+
+    queueCond.notify_all();
+
+    // help instead of sleeping, possibly with chunks of other batches
+    while (true) {
+        {
+            lock_guard<mutex> lock(completion->completionMutex);
+            if (completion->remaining == 0)
+                return;
+        }
+        if (!runNextJob(false))
+            break;
+    }
+
+    unique_lock<mutex> lock(completion->completionMutex);
+    completion->completionCond.wait(lock, [&completion]() { return completion->remaining == 0; });
+}
+
+
+bool TransactionHashingPool::runNextJob(bool _wait) {
+
+    Job job;
+
+    {
+        unique_lock<mutex> lock(queueMutex);
+
+        if (_wait) {
+            queueCond.wait(lock, [this]() { return !queue.empty(); });
+        } else if (queue.empty()) {
+            return false;
+        }
+
+        job = std::move(queue.front());
+        queue.pop_front();
+    }
+
+    runJob(job);
+
+    {
+        lock_guard<mutex> lock(job.completion->completionMutex);
+        job.completion->remaining--;
+    }
+
+    job.completion->completionCond.notify_all();
+
+    return true;
+}
+
+
+void TransactionHashingPool::runJob(const Job &_job) {
+    Transaction::computeHashes(*_job.transactions, _job.begin, _job.end);
+}
+
+
+void TransactionHashingPool::workerLoop() {
+
+    setThreadName(__CLASS_NAME__);
+
+    while (true) {
+        runNextJob(true);
+    }
+}
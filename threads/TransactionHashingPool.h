@@ -0,0 +1,85 @@
+/*
+    Copyright (C) 2019 SKALE Labs
+
+    This file is part of skale-consensus.
+
+    skale-consensus is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    skale-consensus is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with skale-consensus.  If not, see <http://www.gnu.org/licenses/>.
+
+    @file TransactionHashingPool.h
+    @author Stan Kladko
+    @date 2019
+*/
+
+
+#pragma once
+
+
+class Transaction;
+
+
+/**
+ * Process-wide pool that computes transaction hashes in parallel before transactions enter the
+ * mempool or a received proposal. A batch is split into chunks, the calling thread works on the
+ * chunks too and returns once all of them are hashed. Small batches are hashed inline.
+ *
+ * The pool threads are idle daemons that live until the process exits, so they are not registered
+ * with WorkerThreadPool and are never joined.
+ */
+class TransactionHashingPool {
+
+    class Completion {
+    public:
+        mutex completionMutex;
+
+        condition_variable completionCond;
+
+        uint64_t remaining = 0;
+    };
+
+    class Job {
+    public:
+        const vector<ptr<Transaction>> *transactions;
+
+        uint64_t begin;
+
+        uint64_t end;
+
+        ptr<Completion> completion;
+    };
+
+    mutex queueMutex;
+
+    condition_variable queueCond;
+
+    deque<Job> queue;
+
+    TransactionHashingPool();
+
+    static TransactionHashingPool &getInstance();
+
+    void workerLoop();
+
+    bool runNextJob(bool _wait);
+
+    static void runJob(const Job &_job);
+
+    void hash(const vector<ptr<Transaction>> &_transactions);
+
+public:
+
+    /**
+     * Computes the hash and the partial hash of every transaction
+     */
+    static void hashTransactions(const vector<ptr<Transaction>> &_transactions);
+};